@@ -12,13 +12,14 @@ CPU::CPU(MMU *mmu)
 {
     printf("Initializing CPU...\n");
     CPU::mmu = mmu;
+    hot = mmu->getHotState();
     // Init values from Pandocs for DMG Gameboy
-    CPU::AF.setWord(0x01B0);
-    CPU::BC.setWord(0x0013);
-    CPU::DE.setWord(0x00D8);
-    CPU::HL.setWord(0x014D);
-    CPU::SP.setWord(0xFFFE);
-    CPU::PC.setWord(0x0100); // PC start location is 0x0100 for practical purposes
+    hot->AF.setWord(0x01B0);
+    hot->BC.setWord(0x0013);
+    hot->DE.setWord(0x00D8);
+    hot->HL.setWord(0x014D);
+    hot->SP.setWord(0xFFFE);
+    hot->PC.setWord(0x0100); // PC start location is 0x0100 for practical purposes
 
     mmu->writeByte(0xFF05, 0x00);
     mmu->writeByte(0xFF06, 0x00);
@@ -40,7 +41,8 @@ CPU::CPU(MMU *mmu)
     mmu->writeByte(0xFF23, 0xBF);
     mmu->writeByte(0xFF24, 0x77);
     mmu->writeByte(0xFF25, 0xF3);
-    mmu->writeByte(0xFF26, 0xF1);
+    // The NR52 channel status bits are read-only, so channel 1 still playing the boot sound is stored directly
+    mmu->writeIO(0xFF26, 0xF1);
     mmu->writeByte(0xFF40, 0x91);
     mmu->writeByte(0xFF42, 0x00);
     mmu->writeByte(0xFF43, 0x00);
@@ -51,6 +53,17 @@ CPU::CPU(MMU *mmu)
     mmu->writeByte(0xFF4A, 0x00);
     mmu->writeByte(0xFF4B, 0x00);
     mmu->writeByte(0xFFFF, 0x00);
+
+    // Any write to DIV resets it, along with the internal counter feeding it
+    mmu->registerIOHandler(DIV_ADDR, nullptr, [](void *context, u16, u8) {
+        CPU *cpu = (CPU *) context;
+        cpu->hot->divCounter = 0;
+        cpu->resetDivider();
+    }, this);
+    // Only the lower 3 bits of TAC exist
+    mmu->registerIOHandler(TAC_ADDR, [](void *context, u16 location) -> u8 {
+        return ((CPU *) context)->mmu->readIO(location) | 0xF8;
+    }, nullptr, this);
 }
 
 CPU::~CPU() {}
@@ -58,84 +71,82 @@ CPU::~CPU() {}
 // REGISTERS
 u16 CPU::getSP()
 {
-    return CPU::SP.getWord();
+    return hot->SP.getWord();
 }
 void CPU::setSP(u16 value)
 {
-    CPU::SP.setWord(value);
+    hot->SP.setWord(value);
 }
 u16 CPU::getPC()
 {
-    return CPU::PC.getWord();
+    return hot->PC.getWord();
 }
 void CPU::setPC(u16 value)
 {
-    CPU::PC.setWord(value);
+    hot->PC.setWord(value);
 }
 
 bool CPU::getIME()
 {
-    return CPU::IME;
+    return hot->IME;
 }
 void CPU::setIME(bool value)
 {
-    CPU::IME = value;
+    hot->IME = value;
 }
 
 
 void CPU::pushStackWord(u16 word) {
     // Push word to stack and decrement the pointer
     // Decrement push lower byte
-    SP.setWord(SP.getWord() - 1);
+    hot->SP.setWord(hot->SP.getWord() - 1);
     u8 lower = (u8) (word & 0x00FF);
-    mmu->writeByte(SP.getWord(), lower);
+    mmu->writeByte(hot->SP.getWord(), lower);
     // Push higher byte
-    SP.setWord(SP.getWord() - 1);
+    hot->SP.setWord(hot->SP.getWord() - 1);
     u8 higher = (u8) ((word & 0xFF00) >> 8);
-    mmu->writeByte(SP.getWord(), higher);
+    mmu->writeByte(hot->SP.getWord(), higher);
 }
 
 // Flag Operations
 
 bool CPU::getZeroFlag()
 {
-    return CPU::AF.lower & ZERO_VALUE;
+    return hot->AF.lower & ZERO_VALUE;
 }
 void CPU::setZeroFlag(bool set)
 {
-    CPU::AF.lower = set ? CPU::AF.lower | ZERO_VALUE : CPU::AF.lower & ~ZERO_VALUE;
+    hot->AF.lower = set ? hot->AF.lower | ZERO_VALUE : hot->AF.lower & ~ZERO_VALUE;
 }
 bool CPU::getSubFlag()
 {
-    return CPU::AF.lower & SUB_VALUE;
+    return hot->AF.lower & SUB_VALUE;
 }
 void CPU::setSubFlag(bool set)
 {
-    CPU::AF.lower = set ? CPU::AF.lower | SUB_VALUE : CPU::AF.lower & ~SUB_VALUE;
+    hot->AF.lower = set ? hot->AF.lower | SUB_VALUE : hot->AF.lower & ~SUB_VALUE;
 }
 bool CPU::getHCarryFlag()
 {
-    return CPU::AF.lower & HALF_VALUE;
+    return hot->AF.lower & HALF_VALUE;
 }
 void CPU::setHCarryFlag(bool set)
 {
-    CPU::AF.lower = set ? CPU::AF.lower | HALF_VALUE : CPU::AF.lower & ~HALF_VALUE;
+    hot->AF.lower = set ? hot->AF.lower | HALF_VALUE : hot->AF.lower & ~HALF_VALUE;
 }
 bool CPU::getCarryFlag()
 {
-    return CPU::AF.lower & CARRY_VALUE;
+    return hot->AF.lower & CARRY_VALUE;
 }
 void CPU::setCarryFlag(bool set)
 {
-    CPU::AF.lower = set ? CPU::AF.lower | CARRY_VALUE : CPU::AF.lower & ~CARRY_VALUE;
+    hot->AF.lower = set ? hot->AF.lower | CARRY_VALUE : hot->AF.lower & ~CARRY_VALUE;
 }
 
 // Interrupts
 void CPU::requestInterrupt(u8 interrupt)
 {
-    u8 IF = mmu->readByte(0xFF0F);
-    IF |= interrupt;
-    mmu->writeByte(0xFF0F, IF);
+    mmu->requestInterrupt(interrupt);
 }
 
 // Flag Helpers
@@ -159,37 +170,37 @@ bool CPU::checkCarry_16(u16 arg1, u16 arg2)
 // Timer
 u8 CPU::getDivider()
 {
-    return mmu->readByte(DIV_ADDR);
+    return mmu->readIO(DIV_ADDR);
 }
 
 u8 CPU::getTimer()
 {
-    return mmu->readByte(TIMA_ADDR);
+    return mmu->readIO(TIMA_ADDR);
 }
 
 u8 CPU::getTimerModulo()
 {
-    return mmu->readByte(TMA_ADDR);
+    return mmu->readIO(TMA_ADDR);
 }
 
 void CPU::resetDivider()
 {
-    mmu->writeByte(DIV_ADDR, 0x00);
+    mmu->writeIO(DIV_ADDR, 0x00);
 }
 
 void CPU::setDivider(u8 value)
 {
-    mmu->writeByte(DIV_ADDR, value);
+    mmu->writeIO(DIV_ADDR, value);
 }
 
 void CPU::setTimer(u8 value)
 {
-    mmu->writeByte(TIMA_ADDR, value);
+    mmu->writeIO(TIMA_ADDR, value);
 }
 
 void CPU::setTimerModulo(u8 value)
 {
-    mmu->writeByte(TMA_ADDR, value);
+    mmu->writeIO(TMA_ADDR, value);
 }
 
 void CPU::updateTimer(int instructionCycles)
@@ -197,8 +208,8 @@ void CPU::updateTimer(int instructionCycles)
     // Update DIV before timer, independent of timer control
     int cpuCycles = 4 * instructionCycles; // T cycles
 
-    divCounter += cpuCycles;
-    while (divCounter >= (CPU_CLOCK_SPEED / DIV_SPEED))
+    hot->divCounter += cpuCycles;
+    while (hot->divCounter >= (CPU_CLOCK_SPEED / DIV_SPEED))
     { // If enough CPU cycles have passed, (256) increment divider
         u8 divider = getDivider();
         if (divider == 0xFF) // Reset once divider hits 255
@@ -206,11 +217,11 @@ void CPU::updateTimer(int instructionCycles)
         else
             setDivider(divider + 1);
 
-        divCounter -= CPU_CLOCK_SPEED / DIV_SPEED;
+        hot->divCounter -= CPU_CLOCK_SPEED / DIV_SPEED;
     }
 
-    u8 TAC = mmu->readByte(TAC_ADDR); // Get TAC byte
-    if (TAC & 0x04 == 0x00)
+    u8 TAC = mmu->readIO(TAC_ADDR); // Get TAC byte
+    if ((TAC & 0x04) == 0x00)
         return; // do not do anything if timer is disabled
 
     // Frequency of TIMA is determined by bits 1 and 0 of TAC
@@ -234,24 +245,67 @@ void CPU::updateTimer(int instructionCycles)
         break;
     }
 
-    timerCounter += cpuCycles;
-    while (timerCounter >= CPU_CLOCK_SPEED / frequency)
+    hot->timerCounter += cpuCycles;
+    while (hot->timerCounter >= CPU_CLOCK_SPEED / frequency)
     {
         u8 TIMA = getTimer();
         if (TIMA == 0xFF)
         {
             setTimer(getTimerModulo());
-            // [TODO] SET INTERRUPT
+            requestInterrupt(0x04);
         }
-        timerCounter -= CPU_CLOCK_SPEED / frequency;
+        else
+            setTimer(TIMA + 1);
+        hot->timerCounter -= CPU_CLOCK_SPEED / frequency;
     }
 }
 
+void CPU::startBootROM()
+{
+    hot->AF.setWord(0x0000);
+    hot->BC.setWord(0x0000);
+    hot->DE.setWord(0x0000);
+    hot->HL.setWord(0x0000);
+    hot->SP.setWord(0x0000);
+    hot->PC.setWord(0x0000);
+    hot->IME = false;
+    hot->divCounter = 0;
+    hot->timerCounter = 0;
+}
+
+CPUState CPU::saveState()
+{
+    return {hot->AF.getWord(), hot->BC.getWord(), hot->DE.getWord(), hot->HL.getWord(), hot->SP.getWord(), hot->PC.getWord(),
+            hot->IME, hot->divCounter, hot->timerCounter, hot->cycles, hot->nextEvent};
+}
+
+void CPU::loadState(const CPUState &state)
+{
+    hot->AF.setWord(state.AF);
+    hot->BC.setWord(state.BC);
+    hot->DE.setWord(state.DE);
+    hot->HL.setWord(state.HL);
+    hot->SP.setWord(state.SP);
+    hot->PC.setWord(state.PC);
+    hot->IME = state.IME;
+    hot->divCounter = state.divCounter;
+    hot->timerCounter = state.timerCounter;
+    hot->cycles = state.cycles;
+    hot->nextEvent = state.nextEvent;
+}
+
 u8 CPU::getInstruction()
 {
-    u8 opcode = mmu->readByte(PC.getWord());
+    u8 opcode = mmu->readByte(hot->PC.getWord());
     // update PC
-    PC.setWord(PC.getWord() + 1);
+    hot->PC.setWord(hot->PC.getWord() + 1);
+    return opcode;
+}
+
+u8 CPU::fetchOpcode()
+{
+    u8 opcode = mmu->fetchByte(hot->PC.getWord());
+    hot->PC.setWord(hot->PC.getWord() + 1);
     return opcode;
 }
 
@@ -274,7 +328,7 @@ int CPU::executeInstruction(u8 instruction)
         if(!getZeroFlag())
         {
             signed char step = CPU::getInstruction();
-            PC.setWord(PC.getWord() + step);
+            hot->PC.setWord(hot->PC.getWord() + step);
             return 3;
         } 
         return 2;
@@ -283,206 +337,206 @@ int CPU::executeInstruction(u8 instruction)
         if(!getCarryFlag())
         {
             signed char step = CPU::getInstruction();
-            PC.setWord(PC.getWord() + step);
+            hot->PC.setWord(hot->PC.getWord() + step);
             return 3;
         } 
         return 2;
     // LD B, B
     case 0x40:
-        BC.lower = BC.lower;
+        hot->BC.lower = hot->BC.lower;
         return 1;
     // LD D, B
     case 0x50:
-        DE.lower = BC.lower;
+        hot->DE.lower = hot->BC.lower;
         return 1;
     // LD H, B
     case 0x60:
-        HL.lower = BC.lower;
+        hot->HL.lower = hot->BC.lower;
         return 1;
     // LD (HL), B
     case 0x70:
-        mmu->writeWord(HL.getWord(), BC.lower);
+        mmu->writeWord(hot->HL.getWord(), hot->BC.lower);
         return 2;
     // LD BC,u16
     case 0x01:
-        BC.lower = CPU::getInstruction();
-        BC.higher = CPU::getInstruction();
+        hot->BC.lower = CPU::getInstruction();
+        hot->BC.higher = CPU::getInstruction();
         return 3;
     // LD DE, u16
     case 0x11:
-        DE.lower = CPU::getInstruction();
-        DE.higher = CPU::getInstruction();
+        hot->DE.lower = CPU::getInstruction();
+        hot->DE.higher = CPU::getInstruction();
         return 3;
     // LD HL, u16
     case 0x21:
-        HL.lower = CPU::getInstruction();
-        HL.higher = CPU::getInstruction();
+        hot->HL.lower = CPU::getInstruction();
+        hot->HL.higher = CPU::getInstruction();
         return 3;
     // LD SP, u16
     case 0x31:
-        SP.lower = CPU::getInstruction();
-        SP.higher = CPU::getInstruction();
+        hot->SP.lower = CPU::getInstruction();
+        hot->SP.higher = CPU::getInstruction();
         return 3;
     // LD B, C
     case 0x41:
-        BC.lower = BC.higher;
+        hot->BC.lower = hot->BC.higher;
         return 1;
     // LD D, C
     case 0x51:
-        DE.lower = BC.higher;
+        hot->DE.lower = hot->BC.higher;
         return 1;
     // LD H, C
     case 0x61:
-        HL.lower = BC.higher;
+        hot->HL.lower = hot->BC.higher;
         return 1;
     // LD (HL), C
     case 0x71:
-        mmu->writeWord(HL.getWord(), BC.higher);
+        mmu->writeWord(hot->HL.getWord(), hot->BC.higher);
         return 2;
     // LD (BC),A
     case 0x02:
-        mmu->writeWord(HL.getWord(), AF.lower);
+        mmu->writeWord(hot->HL.getWord(), hot->AF.lower);
         return 2;
     // LD (DE),A
     case 0x12:
-        mmu->writeWord(DE.getWord(), AF.lower);
+        mmu->writeWord(hot->DE.getWord(), hot->AF.lower);
         return 2;
     // LD (HL+),A
     case 0x22:
-        mmu->writeWord(HL.getWord(), AF.lower);
-        HL.setWord(HL.getWord() + 1);
+        mmu->writeWord(hot->HL.getWord(), hot->AF.lower);
+        hot->HL.setWord(hot->HL.getWord() + 1);
         return 2;
     // LD (HL-),A
     case 0x32:
-        mmu->writeWord(HL.getWord(), AF.lower);
-        HL.setWord(HL.getWord() - 1);
+        mmu->writeWord(hot->HL.getWord(), hot->AF.lower);
+        hot->HL.setWord(hot->HL.getWord() - 1);
         return 2;
     // LD B, D
     case 0x42:
-        BC.lower = DE.lower;
+        hot->BC.lower = hot->DE.lower;
         return 1;
     // LD D, D
     case 0x52:
-        DE.lower = DE.lower;
+        hot->DE.lower = hot->DE.lower;
         return 1;
     // LD H, D
     case 0x62:
-        HL.lower = DE.lower;
+        hot->HL.lower = hot->DE.lower;
         return 1;
     // LD (HL), D
     case 0x72:
-        mmu->writeWord(HL.getWord(), DE.lower);
+        mmu->writeWord(hot->HL.getWord(), hot->DE.lower);
         return 2;
     // INC BC ? should be 16 bit operation:
     case 0x03:
     {
-        CPU::inc_16(&BC);
+        CPU::inc_16(&hot->BC);
         return 3;
     }
     // INC DE
     case 0x13:
     {
-        CPU::inc_16(&DE);
+        CPU::inc_16(&hot->DE);
         return 3;
     }
     // INC HL
     case 0x23:
     {
-        CPU::inc_16(&HL);
+        CPU::inc_16(&hot->HL);
         return 3;
     }
     // INC SP
     case 0x33:
     {
-        CPU::inc_16(&SP);
+        CPU::inc_16(&hot->SP);
         return 3;
     }
     // LD B, E
     case 0x43:
-        BC.lower = DE.higher;
+        hot->BC.lower = hot->DE.higher;
         return 1;
     // LD D, D
     case 0x53:
-        DE.lower = DE.higher;
+        hot->DE.lower = hot->DE.higher;
         return 1;
     // LD H, D
     case 0x63:
-        HL.lower = DE.higher;
+        hot->HL.lower = hot->DE.higher;
         return 1;
     // LD (HL), D
     case 0x73:
-        mmu->writeWord(HL.getWord(), DE.higher);
+        mmu->writeWord(hot->HL.getWord(), hot->DE.higher);
         return 2;
     // INC B
     case 0x04:
     {
-        CPU::inc_8(&BC.lower);
+        CPU::inc_8(&hot->BC.lower);
         return 1;
     }
     // INC D
     case 0x14:
     {
-        CPU::inc_8(&DE.lower);
+        CPU::inc_8(&hot->DE.lower);
         return 1;
     }
     // INC H
     case 0x24:
     {
-        CPU::inc_8(&HL.lower);
+        CPU::inc_8(&hot->HL.lower);
         return 1;
     }
     // INC (HL)
     case 0x34:
     {
-        u8 byte = mmu->readByte(HL.getWord());
+        u8 byte = mmu->readByte(hot->HL.getWord());
         u8 res = byte + 1;
-        mmu->writeByte(HL.getWord(), res);
+        mmu->writeByte(hot->HL.getWord(), res);
         CPU::setZeroFlag(!res);
         CPU::setSubFlag(0);
-        CPU::setHCarryFlag(CPU::checkHCarry_16(HL.getWord(), 1, res));
-        CPU::setCarryFlag(CPU::checkCarry_16(HL.getWord(), 1));
+        CPU::setHCarryFlag(CPU::checkHCarry_16(hot->HL.getWord(), 1, res));
+        CPU::setCarryFlag(CPU::checkCarry_16(hot->HL.getWord(), 1));
         return 2;
     }
     // LD B, H
     case 0x44:
-        BC.lower = HL.lower;
+        hot->BC.lower = hot->HL.lower;
         return 1;
     // LD D, H
     case 0x54:
-        DE.lower = HL.lower;
+        hot->DE.lower = hot->HL.lower;
         return 1;
     // LD H, H
     case 0x64:
-        HL.lower = HL.lower;
+        hot->HL.lower = hot->HL.lower;
         return 1;
     // LD (HL), H
     case 0x74:
-        mmu->writeWord(HL.getWord(), HL.lower);
+        mmu->writeWord(hot->HL.getWord(), hot->HL.lower);
         return 2;
     // DEC B
     case 0x05:
     {
-        CPU::dec_8(&BC.lower);
+        CPU::dec_8(&hot->BC.lower);
         return 1;
     }
     // DEC D
     case 0x15:
     {
-        CPU::dec_8(&DE.lower);
+        CPU::dec_8(&hot->DE.lower);
         return 1;
     }
     // DEC H
     case 0x25:
     {
-        CPU::dec_8(&HL.lower);
+        CPU::dec_8(&hot->HL.lower);
         return 1;
     }
     // DEC (HL)
     case 0x35:
     {
-        u8 byte = mmu->readByte(HL.getWord());
+        u8 byte = mmu->readByte(hot->HL.getWord());
         u8 res = byte - 1;
-        mmu->writeWord(HL.getWord(), res);
+        mmu->writeWord(hot->HL.getWord(), res);
         CPU::setZeroFlag(!res);
         CPU::setSubFlag(1);
         CPU::setHCarryFlag(CPU::checkHCarry_8(byte, -1, res));
@@ -491,324 +545,324 @@ int CPU::executeInstruction(u8 instruction)
     }
     // LD B, L
     case 0x45:
-        BC.lower = HL.higher;
+        hot->BC.lower = hot->HL.higher;
         return 1;
     // LD D, L
     case 0x55:
-        DE.lower = HL.higher;
+        hot->DE.lower = hot->HL.higher;
         return 1;
     // LD H, L
     case 0x65:
-        HL.lower = HL.higher;
+        hot->HL.lower = hot->HL.higher;
         return 1;
     // LD (HL), L
     case 0x75:
-        mmu->writeWord(HL.getWord(), HL.higher);
+        mmu->writeWord(hot->HL.getWord(), hot->HL.higher);
         return 2;
     // LD B,u8
     case 0x06:
-        BC.lower = CPU::getInstruction();
+        hot->BC.lower = CPU::getInstruction();
         return 2;
     // RLCA
     case 0x07:
         return 0;
     // LD B, A
     case 0x47:
-        BC.lower = AF.lower;
+        hot->BC.lower = hot->AF.lower;
         return 1;
     // LD D, A
     case 0x57:
-        DE.lower = AF.lower;
+        hot->DE.lower = hot->AF.lower;
         return 1;
     // LD H, A
     case 0x67:
-        HL.lower = AF.lower;
+        hot->HL.lower = hot->AF.lower;
         return 1;
     // LD (HL), A
     case 0x77:
-        mmu->writeWord(HL.getWord(), AF.lower);
+        mmu->writeWord(hot->HL.getWord(), hot->AF.lower);
         return 2;
     case 0x08:
     {
-        u16 nn = mmu->readWord(PC.getWord() + 1);
-        PC.setWord(PC.getWord() + 1);
-        SP.setWord(nn);
+        u16 nn = mmu->readWord(hot->PC.getWord() + 1);
+        hot->PC.setWord(hot->PC.getWord() + 1);
+        hot->SP.setWord(nn);
         return 5;
     }
     // LD C, B
     case 0x48:
-        BC.higher = BC.lower;
+        hot->BC.higher = hot->BC.lower;
         return 1;
     // LD E, B
     case 0x58:
-        DE.higher = BC.lower;
+        hot->DE.higher = hot->BC.lower;
         return 1;
     // LD L, B
     case 0x68:
-        HL.higher = BC.lower;
+        hot->HL.higher = hot->BC.lower;
         return 1;
     // LD A, B
     case 0x78:
-        AF.lower = BC.lower;
+        hot->AF.lower = hot->BC.lower;
         return 1;
     // ADD HL,BC ? is machine cycle 2?
     case 0x09:
     {
-        CPU::add_16(BC.getWord());
+        CPU::add_16(hot->BC.getWord());
         return 2;
     }
     // ADD HL,DE
     case 0x19:
     {
-        CPU::add_16(DE.getWord());
+        CPU::add_16(hot->DE.getWord());
         return 2;
     }
     // ADD HL,HL
     case 0x29:
     {
-        CPU::add_16(HL.getWord());
+        CPU::add_16(hot->HL.getWord());
         return 2;
     }
     // ADD HL,SP
     case 0x39:
     {
-        CPU::add_16(SP.getWord());
+        CPU::add_16(hot->SP.getWord());
         return 2;
     }
     // LD C, C
     case 0x49:
-        BC.higher = BC.higher;
+        hot->BC.higher = hot->BC.higher;
         return 1;
     // LD E, C
     case 0x59:
-        DE.higher = BC.higher;
+        hot->DE.higher = hot->BC.higher;
         return 1;
     // LD L, C
     case 0x69:
-        HL.higher = BC.higher;
+        hot->HL.higher = hot->BC.higher;
         return 1;
     // LD A, C
     case 0x79:
-        AF.lower = BC.higher;
+        hot->AF.lower = hot->BC.higher;
         return 1;
     // LD C, D
     case 0x4A:
-        BC.higher = DE.lower;
+        hot->BC.higher = hot->DE.lower;
         return 1;
     // LD E, D
     case 0x5A:
-        DE.higher = DE.lower;
+        hot->DE.higher = hot->DE.lower;
         return 1;
     // LD L, D
     case 0x6A:
-        HL.higher = DE.lower;
+        hot->HL.higher = hot->DE.lower;
         return 1;
     // LD A, D
     case 0x7A:
-        AF.lower = DE.lower;
+        hot->AF.lower = hot->DE.lower;
         return 1;
     // DEC BC
     case 0x0B:
     {
-        CPU::dec_16(&BC);
+        CPU::dec_16(&hot->BC);
         return 3;
     }
     // DEC DE
     case 0x1B:
     {
-        CPU::dec_16(&DE);
+        CPU::dec_16(&hot->DE);
         return 3;
     }
     // DEC HL
     case 0x2B:
     {
-        CPU::dec_16(&HL);
+        CPU::dec_16(&hot->HL);
         return 3;
     }
     // DEC SP
     case 0x3B:
     {
-        CPU::dec_16(&SP);
+        CPU::dec_16(&hot->SP);
         return 3;
     }
     // LD C, E
     case 0x4B:
-        BC.higher = DE.higher;
+        hot->BC.higher = hot->DE.higher;
         return 1;
     // LD E, E
     case 0x5B:
-        DE.higher = DE.higher;
+        hot->DE.higher = hot->DE.higher;
         return 1;
     // LD L, E
     case 0x6B:
-        HL.higher = DE.higher;
+        hot->HL.higher = hot->DE.higher;
         return 1;
     // LD A, D
     case 0x7B:
-        AF.lower = DE.higher;
+        hot->AF.lower = hot->DE.higher;
         return 1;
     // INC C
     case 0x0C:
     {
-        CPU::inc_8(&BC.higher);
+        CPU::inc_8(&hot->BC.higher);
         return 1;
     }
     // INC E
     case 0x1C:
     {
-        CPU::inc_8(&DE.higher);
+        CPU::inc_8(&hot->DE.higher);
         return 1;
     }
     // INC L
     case 0x2C:
     {
-        CPU::inc_8(&HL.higher);
+        CPU::inc_8(&hot->HL.higher);
         return 1;
     }
     // INC A
     case 0x3C:
     {
-        CPU::inc_8(&AF.lower);
+        CPU::inc_8(&hot->AF.lower);
         return 1;
     }
     // LD C, H
     case 0x4C:
-        BC.higher = HL.lower;
+        hot->BC.higher = hot->HL.lower;
         return 1;
     // LD E, H
     case 0x5C:
-        DE.higher = HL.lower;
+        hot->DE.higher = hot->HL.lower;
         return 1;
     // LD L, H
     case 0x6C:
-        HL.higher = HL.lower;
+        hot->HL.higher = hot->HL.lower;
         return 1;
     // LD A, H
     case 0x7C:
-        AF.lower = HL.lower;
+        hot->AF.lower = hot->HL.lower;
         return 1;
     // DEC C
     case 0x0D:
     {
-        CPU::dec_8(&BC.higher);
+        CPU::dec_8(&hot->BC.higher);
         return 1;
     }
     // DEC E
     case 0x1D:
     {
-        CPU::dec_8(&DE.higher);
+        CPU::dec_8(&hot->DE.higher);
         return 1;
     }
     // DEC L
     case 0x2D:
     {
-        CPU::dec_8(&HL.higher);
+        CPU::dec_8(&hot->HL.higher);
         return 1;
     }
     // DEC A
     case 0x3D:
     {
-        CPU::dec_8(&AF.lower);
+        CPU::dec_8(&hot->AF.lower);
         return 1;
     }
     // LD C, L
     case 0x4D:
-        BC.higher = HL.higher;
+        hot->BC.higher = hot->HL.higher;
         return 1;
     // LD E, L
     case 0x5D:
-        DE.higher = HL.higher;
+        hot->DE.higher = hot->HL.higher;
         return 1;
     // LD L, L
     case 0x6D:
-        HL.higher = HL.higher;
+        hot->HL.higher = hot->HL.higher;
         return 1;
     // LD A, L
     case 0x7D:
-        AF.lower = HL.higher;
+        hot->AF.lower = hot->HL.higher;
         return 1;
     // LD C, u8
     case 0x0E:
-        BC.higher = CPU::getInstruction();
+        hot->BC.higher = CPU::getInstruction();
         return 2;
     // LD E, u8
     case 0x1E:
-        DE.higher = CPU::getInstruction();
+        hot->DE.higher = CPU::getInstruction();
         return 2;
     // LD L, u8
     case 0x2E:
-        HL.higher = CPU::getInstruction();
+        hot->HL.higher = CPU::getInstruction();
         return 2;
     // LD A, u8
     case 0x3E:
-        AF.lower = CPU::getInstruction();
+        hot->AF.lower = CPU::getInstruction();
         return 2;
     // LD C, (HL)
     case 0x4E:
-        BC.higher = mmu->readByte(HL.getWord());
+        hot->BC.higher = mmu->readByte(hot->HL.getWord());
         return 1;
     // LD E, (HL)
     case 0x5E:
-        DE.higher = mmu->readByte(HL.getWord());
+        hot->DE.higher = mmu->readByte(hot->HL.getWord());
         return 1;
     // LD L, (HL)
     case 0x6E:
-        HL.higher = mmu->readByte(HL.getWord());
+        hot->HL.higher = mmu->readByte(hot->HL.getWord());
         return 1;
     // LD A, (HL)
     case 0x7E:
-        AF.lower = mmu->readByte(HL.getWord());
+        hot->AF.lower = mmu->readByte(hot->HL.getWord());
         return 1;
     // LD C, A
     case 0x4F:
-        BC.higher = AF.lower;
+        hot->BC.higher = hot->AF.lower;
         return 1;
     // LD E, A
     case 0x5F:
-        DE.higher = AF.lower;
+        hot->DE.higher = hot->AF.lower;
         return 1;
     // LD L, A
     case 0x6F:
-        HL.higher = AF.lower;
+        hot->HL.higher = hot->AF.lower;
         return 1;
     // LD A, A
     case 0x7F:
-        AF.lower = AF.lower;
+        hot->AF.lower = hot->AF.lower;
         return 1;
     // ADD A, B
     case 0x80:
     {
-        CPU::add_8(BC.lower);
+        CPU::add_8(hot->BC.lower);
         return 1;
     }
     // ADD A, C
     case 0x81:
     {
-        CPU::add_8(BC.higher);
+        CPU::add_8(hot->BC.higher);
         return 1;
     }
     // ADD A, D
     case 0x82:
     {
-        CPU::add_8(DE.lower);
+        CPU::add_8(hot->DE.lower);
         return 1;
     }
     // ADD A, E
     case 0x83:
     {
-        CPU::add_8(DE.higher);
+        CPU::add_8(hot->DE.higher);
         return 1;
     }
     // ADD A, H
     case 0x84:
     {
-        CPU::add_8(HL.lower);
+        CPU::add_8(hot->HL.lower);
         return 1;
     }
     // ADD A, L
     case 0x85:
     {
-        CPU::add_8(HL.higher);
+        CPU::add_8(hot->HL.higher);
         return 1;
     }
     // ADD A, (HL)
@@ -817,50 +871,50 @@ int CPU::executeInstruction(u8 instruction)
     // stores result back into the A register.
     case 0x86:
     {
-        int result, carry_bit = AF.higher + mmu->readByte(HL.getWord());
-        CPU::add_8(mmu->readByte(HL.getWord()));
+        int result, carry_bit = hot->AF.higher + mmu->readByte(hot->HL.getWord());
+        CPU::add_8(mmu->readByte(hot->HL.getWord()));
         return 1;
     }
     // ADD A, A
     case 0x87:
     {
-        CPU::add_8(AF.lower);
+        CPU::add_8(hot->AF.lower);
         return 1;
     }
     // ADC A, B
     case 0x88:
     {
-        CPU::add_8(BC.lower + CPU::getCarryFlag());
+        CPU::add_8(hot->BC.lower + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, C
     case 0x89:
     {
-        CPU::add_8(BC.higher + CPU::getCarryFlag());
+        CPU::add_8(hot->BC.higher + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, D
     case 0x8A:
     {
-        CPU::add_8(DE.lower + CPU::getCarryFlag());
+        CPU::add_8(hot->DE.lower + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, E
     case 0x8B:
     {
-        CPU::add_8(DE.higher + CPU::getCarryFlag());
+        CPU::add_8(hot->DE.higher + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, H
     case 0x8C:
     {
-        CPU::add_8(HL.lower + CPU::getCarryFlag());
+        CPU::add_8(hot->HL.lower + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, L
     case 0x8D:
     {
-        CPU::add_8(HL.higher + CPU::getCarryFlag());
+        CPU::add_8(hot->HL.higher + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, (HL)
@@ -869,49 +923,49 @@ int CPU::executeInstruction(u8 instruction)
     // and stores the result back into the A register.
     case 0x8E:
     {
-        CPU::add_8(mmu->readByte(HL.getWord()) + CPU::getCarryFlag());
+        CPU::add_8(mmu->readByte(hot->HL.getWord()) + CPU::getCarryFlag());
         return 1;
     }
     // ADC A, A
     case 0x8F:
     {
-        CPU::add_8(AF.lower + CPU::getCarryFlag());
+        CPU::add_8(hot->AF.lower + CPU::getCarryFlag());
         return 1;
     }
     // SUB A, B
     case 0x90:
     {
-        CPU::sub_a(BC.lower);
+        CPU::sub_a(hot->BC.lower);
         return 1;
     }
     // SUB A, C
     case 0x91:
     {
-        CPU::sub_a(BC.higher);
+        CPU::sub_a(hot->BC.higher);
         return 1;
     }
     // SUB A, D
     case 0x92:
     {
-        CPU::sub_a(DE.lower);
+        CPU::sub_a(hot->DE.lower);
         return 1;
     }
     // SUB A, E
     case 0x93:
     {
-        CPU::sub_a(DE.higher);
+        CPU::sub_a(hot->DE.higher);
         return 1;
     }
     // SUB A, H
     case 0x94:
     {
-        CPU::sub_a(HL.lower);
+        CPU::sub_a(hot->HL.lower);
         return 1;
     }
     // SUB A, L
     case 0x95:
     {
-        CPU::sub_a(HL.higher);
+        CPU::sub_a(hot->HL.higher);
         return 1;
     }
     // SUB A, (HL)
@@ -920,49 +974,49 @@ int CPU::executeInstruction(u8 instruction)
     // and stores the result back into the A register.
     case 0x96:
     {
-        CPU::sub_a(mmu->readByte(HL.getWord()));
+        CPU::sub_a(mmu->readByte(hot->HL.getWord()));
         return 2;
     }
     // SUB A, A
     case 0x97:
     {
-        CPU::sub_a(AF.lower);
+        CPU::sub_a(hot->AF.lower);
         return 1;
     }
     // SBC A, B
     case 0x98:
     {
-        CPU::sub_a(BC.lower - CPU::getCarryFlag());
+        CPU::sub_a(hot->BC.lower - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, C
     case 0x99:
     {
-        CPU::sub_a(BC.higher - CPU::getCarryFlag());
+        CPU::sub_a(hot->BC.higher - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, D
     case 0x9A:
     {
-        CPU::sub_a(DE.lower - CPU::getCarryFlag());
+        CPU::sub_a(hot->DE.lower - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, E
     case 0x9B:
     {
-        CPU::sub_a(DE.higher - CPU::getCarryFlag());
+        CPU::sub_a(hot->DE.higher - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, H
     case 0x9C:
     {
-        CPU::sub_a(HL.lower - CPU::getCarryFlag());
+        CPU::sub_a(hot->HL.lower - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, L
     case 0x9D:
     {
-        CPU::sub_a(HL.higher - CPU::getCarryFlag());
+        CPU::sub_a(hot->HL.higher - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, (HL)
@@ -971,161 +1025,161 @@ int CPU::executeInstruction(u8 instruction)
     // and stores the result back into the A register.
     case 0x9E:
     {
-        CPU::sub_a(mmu->readByte(HL.getWord()) - CPU::getCarryFlag());
+        CPU::sub_a(mmu->readByte(hot->HL.getWord()) - CPU::getCarryFlag());
         return 1;
     }
     // SBC A, A
     case 0x9F:
     {
-        CPU::sub_a(AF.lower - CPU::getCarryFlag());
+        CPU::sub_a(hot->AF.lower - CPU::getCarryFlag());
         return 1;
     }
     // AND A, B: Bitwise AND
     case 0xA0:
-        CPU::and_a(BC.lower);
+        CPU::and_a(hot->BC.lower);
         return 1;
     // AND A, C
     case 0xA1:
-        CPU::and_a(BC.higher);
+        CPU::and_a(hot->BC.higher);
         return 1;
     // AND A, D
     case 0xA2:
-        CPU::and_a(DE.lower);
+        CPU::and_a(hot->DE.lower);
         return 1;
     // AND A, E
     case 0xA3:
-        CPU::and_a(DE.higher);
+        CPU::and_a(hot->DE.higher);
         return 1;
     // AND A, H
     case 0xA4:
-        CPU::and_a(HL.lower);
+        CPU::and_a(hot->HL.lower);
         return 1;
     // AND A, L
     case 0xA5:
-        CPU::and_a(HL.higher);
+        CPU::and_a(hot->HL.higher);
         return 1;
     // AND A, (HL)
     case 0xA6:
-        CPU::and_a(mmu->readByte(HL.getWord()));
+        CPU::and_a(mmu->readByte(hot->HL.getWord()));
         return 2;
     // AND A, A
     case 0xA7:
-        CPU::and_a(AF.lower);
+        CPU::and_a(hot->AF.lower);
         return 1;
     // XOR A, B
     case 0xA8:
-        CPU::xor_a(BC.lower);
+        CPU::xor_a(hot->BC.lower);
         return 1;
     // XOR A, C
     case 0xA9:
-        CPU::xor_a(BC.higher);
+        CPU::xor_a(hot->BC.higher);
         return 1;
     // XOR A, D
     case 0xAA:
-        CPU::xor_a(DE.lower);
+        CPU::xor_a(hot->DE.lower);
         return 1;
     // XOR A, E
     case 0xAB:
-        CPU::xor_a(DE.lower);
+        CPU::xor_a(hot->DE.lower);
         ;
         return 1;
     // XOR A, H
     case 0xAC:
-        CPU::xor_a(HL.lower);
+        CPU::xor_a(hot->HL.lower);
         return 1;
     // XOR A, L
     case 0xAD:
-        CPU::xor_a(HL.higher);
+        CPU::xor_a(hot->HL.higher);
         return 1;
     // XOR (HL)
     // Performs a bitwise XOR operation between
     // the 8-bit A register and data from the absolute address specified by the 16-bit register HL,
     // and stores the result back into the A register.
     case 0xAE:
-        CPU::xor_a(mmu->readByte(HL.getWord()));
+        CPU::xor_a(mmu->readByte(hot->HL.getWord()));
         return 2;
     // XOR A,A
     case 0xAF:
-        CPU::xor_a(AF.lower);
+        CPU::xor_a(hot->AF.lower);
         return 1;
     // OR A, B
     case 0xB0:
-        CPU::or_a(BC.lower);
+        CPU::or_a(hot->BC.lower);
         return 1;
     // OR A, C
     case 0xB1:
-        CPU::or_a(BC.higher);
+        CPU::or_a(hot->BC.higher);
         return 1;
     // OR A, D
     case 0xB2:
-        CPU::or_a(DE.lower);
+        CPU::or_a(hot->DE.lower);
         return 1;
     // OR A, E
     case 0xB3:
-        CPU::or_a(DE.higher);
+        CPU::or_a(hot->DE.higher);
         return 1;
     // OR A, H
     case 0xB4:
-        CPU::or_a(HL.lower);
+        CPU::or_a(hot->HL.lower);
         return 1;
     // OR A, L
     case 0xB5:
-        CPU::or_a(HL.higher);
+        CPU::or_a(hot->HL.higher);
         return 1;
     // OR A, (HL)
     case 0xB6:
-        CPU::or_a(mmu->readByte(HL.getWord()));
+        CPU::or_a(mmu->readByte(hot->HL.getWord()));
         return 2;
     // OR A, A
     case 0xB7:
-        CPU::or_a(AF.lower);
+        CPU::or_a(hot->AF.lower);
         return 1;
     // CP A,B
     case 0xB8:
     {
-        CPU::cp(BC.lower);
+        CPU::cp(hot->BC.lower);
         return 1;
     }
     // CP A,C
     case 0xB9:
     {
-        CPU::cp(BC.higher);
+        CPU::cp(hot->BC.higher);
         return 1;
     }
     // CP A,D
     case 0xBA:
     {
-        CPU::cp(DE.lower);
+        CPU::cp(hot->DE.lower);
         return 1;
     }
     // CP A,E
     case 0xBB:
     {
-        CPU::cp(DE.higher);
+        CPU::cp(hot->DE.higher);
         return 1;
     }
     // CP A,H
     case 0xBC:
     {
-        CPU::cp(HL.lower);
+        CPU::cp(hot->HL.lower);
         return 1;
     }
     // CP A,L
     case 0xBD:
     {
-        CPU::cp(HL.higher);
+        CPU::cp(hot->HL.higher);
         return 1;
     }
     // CP A,(HL)
     case 0xBE:
     {
-        CPU::cp(mmu->readByte(HL.getWord()));
+        CPU::cp(mmu->readByte(hot->HL.getWord()));
         return 2;
     }
     // CP A,A
     case 0xBF:
     {
-        CPU::cp(AF.lower);
+        CPU::cp(hot->AF.lower);
         return 1;
     }
     // RET NZ
@@ -1141,7 +1195,7 @@ int CPU::executeInstruction(u8 instruction)
     }
     // POP BC
     case 0xC1:
-        CPU::pop(&BC);
+        CPU::pop(&hot->BC);
         return 3;
     // JP NZ, u16 -- REVIEW
     case 0xC2:
@@ -1228,9 +1282,9 @@ int CPU::executeInstruction(u8 instruction)
     case 0xCE:
     {
         // AF.lower += d8 + CPU::getCarryFlag(); // Don't know how to get d8
-        CPU::setZeroFlag(AF.lower == 0);
-        CPU::setHCarryFlag(AF.lower);
-        CPU::setCarryFlag(AF.lower);
+        CPU::setZeroFlag(hot->AF.lower == 0);
+        CPU::setHCarryFlag(hot->AF.lower);
+        CPU::setCarryFlag(hot->AF.lower);
         return 2;
     }
     // RST 1
@@ -1255,7 +1309,7 @@ int CPU::executeInstruction(u8 instruction)
     // POP DE
     case 0xD1:
     {
-        CPU::pop(&DE);
+        CPU::pop(&hot->DE);
         return 3;
     }
     // JP NC, a16
@@ -1286,11 +1340,11 @@ int CPU::executeInstruction(u8 instruction)
     // PUSH DE
     case 0xD5:
     {
-        SP.setWord(SP.getWord() - 1);
-        DE.higher = mmu->readByte(SP.getWord() - 1);
-        SP.setWord(SP.getWord() - 2);
-        DE.lower = mmu->readByte(SP.getWord());
-        SP.setWord(SP.getWord() - 2);
+        hot->SP.setWord(hot->SP.getWord() - 1);
+        hot->DE.higher = mmu->readByte(hot->SP.getWord() - 1);
+        hot->SP.setWord(hot->SP.getWord() - 2);
+        hot->DE.lower = mmu->readByte(hot->SP.getWord());
+        hot->SP.setWord(hot->SP.getWord() - 2);
         return 4;
     }
     // SUB d8
@@ -1348,7 +1402,7 @@ int CPU::executeInstruction(u8 instruction)
     case 0xDE:
     {
         // AF.lower -= (d8 + CPU::getCarryFlag(AF.lower));
-        CPU::sub_a(AF.lower - CPU::getCarryFlag());
+        CPU::sub_a(hot->AF.lower - CPU::getCarryFlag());
         return 2;
     }
     // RST 3
@@ -1365,7 +1419,7 @@ int CPU::executeInstruction(u8 instruction)
     // POP HL
     case 0xE1:
     {
-        CPU::pop(&HL);
+        CPU::pop(&hot->HL);
         return 3;
     }
     // LD (C), A
@@ -1377,11 +1431,11 @@ int CPU::executeInstruction(u8 instruction)
     // PUSH HL
     case 0xE5:
     {
-        HL.setWord(HL.getWord() - 1);
-        DE.higher = mmu->readByte(HL.getWord() - 1);
-        HL.setWord(HL.getWord() - 2);
-        DE.lower = mmu->readByte(HL.getWord());
-        HL.setWord(HL.getWord() - 2);
+        hot->HL.setWord(hot->HL.getWord() - 1);
+        hot->DE.higher = mmu->readByte(hot->HL.getWord() - 1);
+        hot->HL.setWord(hot->HL.getWord() - 2);
+        hot->DE.lower = mmu->readByte(hot->HL.getWord());
+        hot->HL.setWord(hot->HL.getWord() - 2);
         return 4;
     }
     // AND d8
@@ -1418,7 +1472,7 @@ int CPU::executeInstruction(u8 instruction)
         u8 lower = CPU::getInstruction();
         u8 higher = CPU::getInstruction();
         u16 addr = (higher << 8) | lower;
-        mmu->writeByte(addr, AF.lower);
+        mmu->writeByte(addr, hot->AF.lower);
         // Store the contents of register A in the internal RAM or register specified by the 16-bit immediate operand a16.
         return 4;
     }
@@ -1443,7 +1497,7 @@ int CPU::executeInstruction(u8 instruction)
     // POP AF
     case 0xF1:
     {
-        CPU::pop(&AF);
+        CPU::pop(&hot->AF);
         return 3;
     }
     // LD A, (C)
@@ -1455,11 +1509,11 @@ int CPU::executeInstruction(u8 instruction)
     // PUSH AF
     case 0xF5:
     {
-        SP.setWord(SP.getWord() - 1);
-        AF.higher = mmu->readByte(SP.getWord() - 1);
-        SP.setWord(SP.getWord() - 2);
-        AF.lower = mmu->readByte(SP.getWord());
-        SP.setWord(SP.getWord() - 2);
+        hot->SP.setWord(hot->SP.getWord() - 1);
+        hot->AF.higher = mmu->readByte(hot->SP.getWord() - 1);
+        hot->SP.setWord(hot->SP.getWord() - 2);
+        hot->AF.lower = mmu->readByte(hot->SP.getWord());
+        hot->SP.setWord(hot->SP.getWord() - 2);
         return 4;
     }
     // OR d8
@@ -1480,18 +1534,18 @@ int CPU::executeInstruction(u8 instruction)
         // Add the 8-bit signed operand s8 (values -128 to +127) to the stack pointer SP, 
         // and store the result in register pair HL.
         signed char byte = CPU::getInstruction();
-        u16 res = SP.getWord() + byte;
-        HL.setWord(res); // what to replace for s8?
+        u16 res = hot->SP.getWord() + byte;
+        hot->HL.setWord(res); // what to replace for s8?
         CPU::setZeroFlag(!res);
         CPU::setSubFlag(0);
-        CPU::setHCarryFlag(CPU::checkHCarry_16(SP.getWord(), byte, res));
-        CPU::setCarryFlag(CPU::checkCarry_16(SP.getWord(), byte));
+        CPU::setHCarryFlag(CPU::checkHCarry_16(hot->SP.getWord(), byte, res));
+        CPU::setCarryFlag(CPU::checkCarry_16(hot->SP.getWord(), byte));
         return 3;
     }
     // LD SP, HL
     case 0xF9:
     {
-        SP.setWord(HL.getWord());
+        hot->SP.setWord(hot->HL.getWord());
         return 2;
     }
     // LD A, (a16) -- REVIEW
@@ -1502,13 +1556,13 @@ int CPU::executeInstruction(u8 instruction)
         u8 lower = CPU::getInstruction();
         u8 higher = CPU::getInstruction();
         u16 addr = (higher << 8) | lower;
-        AF.lower = mmu->readByte(addr);
+        hot->AF.lower = mmu->readByte(addr);
         return 4;
     }
     // EI -- REVIEW
     case 0xFB:
     {
-        CPU::IME = true;
+        hot->IME = true;
         return 1;
     }
     // CP d8
@@ -1532,38 +1586,38 @@ int CPU::executeInstruction(u8 instruction)
 
 void CPU::add_8(u8 arg)
 {
-    u16 res = AF.lower + arg;
+    u16 res = hot->AF.lower + arg;
     CPU::setZeroFlag(!res);
     CPU::setSubFlag(false);
-    CPU::setHCarryFlag(CPU::checkHCarry_8(AF.lower, arg, res));
-    CPU::setCarryFlag(CPU::checkCarry_8(AF.lower, arg));
-    AF.lower = res;
+    CPU::setHCarryFlag(CPU::checkHCarry_8(hot->AF.lower, arg, res));
+    CPU::setCarryFlag(CPU::checkCarry_8(hot->AF.lower, arg));
+    hot->AF.lower = res;
 }
 
 void CPU::add_16(u16 arg)
 {
-    u16 res = AF.getWord() + arg;
+    u16 res = hot->AF.getWord() + arg;
     CPU::setZeroFlag(res == 0);
     CPU::setSubFlag(false);
-    CPU::setHCarryFlag(CPU::checkHCarry_16(AF.getWord(), arg, res));
-    CPU::setCarryFlag(CPU::checkCarry_16(AF.getWord(), arg));
-    AF.setWord(res);
+    CPU::setHCarryFlag(CPU::checkHCarry_16(hot->AF.getWord(), arg, res));
+    CPU::setCarryFlag(CPU::checkCarry_16(hot->AF.getWord(), arg));
+    hot->AF.setWord(res);
 }
 
 void CPU::sub_a(u8 arg)
 {
-    u16 res = AF.lower - arg;
+    u16 res = hot->AF.lower - arg;
     CPU::setZeroFlag(!res);
     CPU::setSubFlag(true);
-    CPU::setHCarryFlag(CPU::checkHCarry_8(AF.lower, arg, res));
-    CPU::setCarryFlag(CPU::checkCarry_8(AF.lower, arg));
-    AF.lower = res;
+    CPU::setHCarryFlag(CPU::checkHCarry_8(hot->AF.lower, arg, res));
+    CPU::setCarryFlag(CPU::checkCarry_8(hot->AF.lower, arg));
+    hot->AF.lower = res;
 }
 
 void CPU::or_a(u8 arg)
 {
-    AF.lower |= arg;
-    CPU::setZeroFlag(AF.lower == 0);
+    hot->AF.lower |= arg;
+    CPU::setZeroFlag(hot->AF.lower == 0);
     CPU::setSubFlag(0);
     CPU::setHCarryFlag(0);
     CPU::setCarryFlag(0);
@@ -1571,8 +1625,8 @@ void CPU::or_a(u8 arg)
 
 void CPU::and_a(u8 arg)
 {
-    AF.lower &= arg;
-    CPU::setZeroFlag(AF.lower == 0);
+    hot->AF.lower &= arg;
+    CPU::setZeroFlag(hot->AF.lower == 0);
     CPU::setSubFlag(0);
     CPU::setHCarryFlag(1);
     CPU::setCarryFlag(0);
@@ -1580,63 +1634,63 @@ void CPU::and_a(u8 arg)
 
 void CPU::xor_a(u8 arg)
 {
-    u8 res = AF.lower ^ arg;
+    u8 res = hot->AF.lower ^ arg;
     CPU::setZeroFlag(!res);
     CPU::setSubFlag(false);
     CPU::setHCarryFlag(false);
     CPU::setCarryFlag(false);
-    AF.lower = res;
+    hot->AF.lower = res;
 }
 
 void CPU::cp(u8 arg)
 {
-    u16 res = AF.lower - arg;
+    u16 res = hot->AF.lower - arg;
     CPU::setZeroFlag(!res);
     CPU::setSubFlag(true);
-    CPU::setHCarryFlag(CPU::checkHCarry_8(AF.lower, arg, res));
-    CPU::setCarryFlag(CPU::checkCarry_8(AF.lower, arg));
+    CPU::setHCarryFlag(CPU::checkHCarry_8(hot->AF.lower, arg, res));
+    CPU::setCarryFlag(CPU::checkCarry_8(hot->AF.lower, arg));
 }
 
 void CPU::pop(Register *reg)
 {
-    reg->lower = mmu->readByte(SP.getWord());
-    SP.setWord(SP.getWord() + 1);
-    reg->higher = mmu->readByte(SP.getWord());
-    SP.setWord(SP.getWord() + 1);
+    reg->lower = mmu->readByte(hot->SP.getWord());
+    hot->SP.setWord(hot->SP.getWord() + 1);
+    reg->higher = mmu->readByte(hot->SP.getWord());
+    hot->SP.setWord(hot->SP.getWord() + 1);
 }
 
 void CPU::jp()
 {
     u8 lower = CPU::getInstruction();
     u8 higher = CPU::getInstruction();
-    PC.lower = lower;
-    PC.higher = higher;
+    hot->PC.lower = lower;
+    hot->PC.higher = higher;
 }
 
 void CPU::jp_hl()
 {
-    PC.lower = HL.lower;
-    PC.higher = HL.higher;
+    hot->PC.lower = hot->HL.lower;
+    hot->PC.higher = hot->HL.higher;
 }
 
 void CPU::ret()
 {
-    PC.lower = mmu->readByte(SP.getWord());
-    SP.setWord(SP.getWord() + 1);
-    PC.higher = mmu->readByte(SP.getWord());
-    SP.setWord(SP.getWord() + 1);
+    hot->PC.lower = mmu->readByte(hot->SP.getWord());
+    hot->SP.setWord(hot->SP.getWord() + 1);
+    hot->PC.higher = mmu->readByte(hot->SP.getWord());
+    hot->SP.setWord(hot->SP.getWord() + 1);
 }
 
 void CPU::call()
 {
     u8 lower = CPU::getInstruction();
     u8 higher = CPU::getInstruction();
-    SP.setWord(SP.getWord() - 1);
-    mmu->writeByte(SP.getWord(), PC.higher);
-    SP.setWord(SP.getWord() - 1);
-    mmu->writeByte(SP.getWord(), PC.lower);
-    PC.lower = lower;
-    PC.higher = higher;
+    hot->SP.setWord(hot->SP.getWord() - 1);
+    mmu->writeByte(hot->SP.getWord(), hot->PC.higher);
+    hot->SP.setWord(hot->SP.getWord() - 1);
+    mmu->writeByte(hot->SP.getWord(), hot->PC.lower);
+    hot->PC.lower = lower;
+    hot->PC.higher = higher;
 }
 
 void CPU::inc_8(u8 *reg)
@@ -1687,10 +1741,10 @@ void CPU::dec_16(Register *reg)
 
 void CPU::dumpRegisters()
 {
-    std::cout << "AF: 0x" << std::hex << std::setw(4) << std::setfill('0') << +CPU::AF.getWord() << " (" << std::bitset<16>(CPU::AF.getWord()) << ")\n";
-    std::cout << "BC: 0x" << std::hex << std::setw(4) << std::setfill('0') << +CPU::BC.getWord() << " (" << std::bitset<16>(CPU::BC.getWord()) << ")\n";
-    std::cout << "DE: 0x" << std::hex << std::setw(4) << std::setfill('0') << +CPU::DE.getWord() << " (" << std::bitset<16>(CPU::DE.getWord()) << ")\n";
-    std::cout << "HL: 0x" << std::hex << std::setw(4) << std::setfill('0') << +CPU::HL.getWord() << " (" << std::bitset<16>(CPU::HL.getWord()) << ")\n";
-    std::cout << "SP: 0x" << std::hex << std::setw(4) << std::setfill('0') << +CPU::SP.getWord() << " (" << std::bitset<16>(CPU::SP.getWord()) << ")\n";
-    std::cout << "PC: 0x" << std::hex << std::setw(4) << std::setfill('0') << +CPU::PC.getWord() << " (" << std::bitset<16>(CPU::PC.getWord()) << ")\n\n";
+    std::cout << "AF: 0x" << std::hex << std::setw(4) << std::setfill('0') << +hot->AF.getWord() << " (" << std::bitset<16>(hot->AF.getWord()) << ")\n";
+    std::cout << "BC: 0x" << std::hex << std::setw(4) << std::setfill('0') << +hot->BC.getWord() << " (" << std::bitset<16>(hot->BC.getWord()) << ")\n";
+    std::cout << "DE: 0x" << std::hex << std::setw(4) << std::setfill('0') << +hot->DE.getWord() << " (" << std::bitset<16>(hot->DE.getWord()) << ")\n";
+    std::cout << "HL: 0x" << std::hex << std::setw(4) << std::setfill('0') << +hot->HL.getWord() << " (" << std::bitset<16>(hot->HL.getWord()) << ")\n";
+    std::cout << "SP: 0x" << std::hex << std::setw(4) << std::setfill('0') << +hot->SP.getWord() << " (" << std::bitset<16>(hot->SP.getWord()) << ")\n";
+    std::cout << "PC: 0x" << std::hex << std::setw(4) << std::setfill('0') << +hot->PC.getWord() << " (" << std::bitset<16>(hot->PC.getWord()) << ")\n\n";
 }
\ No newline at end of file
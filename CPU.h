@@ -21,26 +21,28 @@
 #define TAC_2 65536
 #define TAC_3 16384
 
+/**
+ * @brief A copy of the CPU registers and timer counters.
+ */
+struct CPUState
+{
+    u16 AF, BC, DE, HL, SP, PC;
+    bool IME;
+    int divCounter;
+    int timerCounter;
+    u64 cycles;    ///< M-cycles since power on, which an emulated cartridge clock follows.
+    u64 nextEvent; ///< Cycle count at which the main loop next stops.
+};
+
 class CPU
 {
 private:
-    // Registers
-    Register AF;    ///< `A` and `F` register pair (Accumulator and Flag registers).
-    Register BC;    ///< `B` and `C` register pair.
-    Register DE;    ///< `D` and `E` register pair.
-    Register HL;    ///< `H` and `L` register pair.
-    Register PC;    ///< Program Counter.
-    Register SP;    ///< Stack Pointer.
-
-    bool IME = false;   ///< Interrupt Master Enable flag.
+    // Registers, IME and timer counters
+    HotState *hot;  ///< The MMU's hot state block, so registers share cache lines with the I/O page.
 
     // Memory
     MMU *mmu;       ///< Pointer to MMU object associated with the emulator.
 
-    // Timer
-    int divCounter = 0;     ///< Internal counter used to determine the number of CPU cycles passed before incrementing DIV
-    int timerCounter = 0;   ///< Internal counter used to determine the number of CPU cycles passed before incrementing TIMA
-
 public:
     /**
      * @brief Construct a new `CPU` object.
@@ -90,6 +92,12 @@ public:
 
     // Instructions
     u8 getInstruction();
+    /**
+     * @brief Fetches the opcode at PC and advances PC, triggering execute watchpoints.
+     * 
+     * @return `u8` The opcode to pass to executeInstruction.
+     */
+    u8 fetchOpcode();
     /**
      * @brief Given an 8-bit CPU instruction, execute the associated Opcode and update flags as necessary.
      * 
@@ -267,6 +275,26 @@ public:
      */
     void updateTimer(int cycles);
 
+    /**
+     * @brief Clears the registers and starts execution at 0x0000, for running a boot ROM
+     * instead of starting from the post-boot state.
+     */
+    void startBootROM();
+
+    /**
+     * @brief Copies the registers, timer counters and cycle count.
+     * 
+     * @return `CPUState` The current state.
+     */
+    CPUState saveState();
+
+    /**
+     * @brief Restores the registers, timer counters and cycle count.
+     * 
+     * @param state A state returned by saveState.
+     */
+    void loadState(const CPUState &state);
+
     // DEBUG
     void dumpRegisters();
 };
@@ -3,8 +3,72 @@
 #include <cstdio>
 #include <filesystem>
 #include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+const u8 Cartridge::logo[LOGO_SIZE] = {
+    0xCE, 0xED, 0x66, 0x66, 0xCC, 0x0D, 0x00, 0x0B, 0x03, 0x73, 0x00, 0x83, 0x00, 0x0C, 0x00, 0x0D,
+    0x00, 0x08, 0x11, 0x1F, 0x88, 0x89, 0x00, 0x0E, 0xDC, 0xCC, 0x6E, 0xE6, 0xDD, 0xDD, 0xD9, 0x99,
+    0xBB, 0xBB, 0x67, 0x63, 0x6E, 0x0E, 0xEC, 0xCC, 0xDD, 0xDC, 0x99, 0x9F, 0xBB, 0xB9, 0x33, 0x3E
+};
+
+/**
+ * @brief Adds up every byte of a buffer, 64 bytes per iteration where SIMD is available.
+ */
+static u64 sumBytes(const u8 *data, long size) {
+    u64 sum = 0;
+    long i = 0;
+#if defined(__SSE2__)
+    // A sum of absolute differences against zero adds each 8 bytes into a 64-bit lane
+    const __m128i zero = _mm_setzero_si128();
+    __m128i total = zero;
+    for (; i + 64 <= size; i += 64) {
+        __m128i a = _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (data + i)), zero);
+        __m128i b = _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (data + i + 16)), zero);
+        __m128i c = _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (data + i + 32)), zero);
+        __m128i d = _mm_sad_epu8(_mm_loadu_si128((const __m128i *) (data + i + 48)), zero);
+        total = _mm_add_epi64(total, _mm_add_epi64(_mm_add_epi64(a, b), _mm_add_epi64(c, d)));
+    }
+    u64 lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, total);
+    sum = lanes[0] + lanes[1];
+#elif defined(__ARM_NEON)
+    // Pairwise widening adds, flushed into 64-bit lanes once per iteration so nothing overflows
+    uint64x2_t total = vdupq_n_u64(0);
+    for (; i + 64 <= size; i += 64) {
+        uint16x8_t pairs = vpaddlq_u8(vld1q_u8(data + i));
+        pairs = vpadalq_u8(pairs, vld1q_u8(data + i + 16));
+        pairs = vpadalq_u8(pairs, vld1q_u8(data + i + 32));
+        pairs = vpadalq_u8(pairs, vld1q_u8(data + i + 48));
+        total = vpadalq_u32(total, vpaddlq_u16(pairs));
+    }
+    sum = vgetq_lane_u64(total, 0) + vgetq_lane_u64(total, 1);
+#endif
+    for (; i < size; i++) {
+        sum += data[i];
+    }
+    return sum;
+}
 
 Cartridge::Cartridge(std::string gameFile) {
+    gameData = nullptr;
+    fileSize = 0;
+    romSize = 0;
+    ramData = nullptr;
+    ramSize = 0;
+    clockData = nullptr;
+    saveData = nullptr;
+    saveSize = 0;
+    ramMapped = false;
+    header = {};
     loadCartridge(gameFile);
 
 }
@@ -12,51 +76,158 @@ Cartridge::Cartridge(std::string gameFile) {
 bool Cartridge::loadCartridge(std::string gameFile) {
     printf("Loading ROM file: %s\n", gameFile.c_str());
 
-    //  Open ROM file
-    FILE *fp = fopen(gameFile.c_str(), "rb");
-
-    if (!fp) {
-        printf("Cannot open file.\n");
+    // Share the ROM with any other cartridge that loaded the same file
+    rom = ROMImage::load(gameFile);
+    if (!rom) {
         return false;
     }
-
-    // Determine file size
-    fileSize = getFileSize(gameFile);
+    gameData = rom->getData();
+    fileSize = rom->getFileSize();
+    romSize = rom->getSize();
     printf("File size: %ld bytes\n", fileSize);
 
-    // Load ROM into memory
-    gameData = new u8[fileSize];
-    fread(gameData, 1, fileSize, fp);
-
-    if (gameData == NULL) {
-        printf("Unable to allocate memory.\n");
-        fclose(fp);
-        return false;
-    }
-
-    fclose(fp);
-
     // Read header
-    GBHeader header = getHeader(gameData);
+    header = getHeader(gameData);
     printf("Title: %s\n", header.title);
     printf("Cartridge Type: %d\n", header.cartridgeType);
     printf("License Code: 0x%04X\n", header.licenseCode);
 
+    // Allocate external RAM
+    ramSize = getRAMSize(header.ramSizeCode);
+    if (getMapperType() == MBC_2) {
+        // MBC2 RAM is built into the controller, so the header declares none
+        ramSize = MBC2_RAM_SIZE;
+    } else if (ramSize > 0) {
+        // Partial banks are rounded up so a whole bank can be mapped
+        ramSize = std::max(ramSize, (long) RAM_BANK_SIZE);
+    }
+    // The MBC3 clock is stored after the RAM banks
+    saveSize = ramSize + (hasClock() ? RTC_SAVE_SIZE : 0);
+    if (saveSize > 0) {
+        // Battery-backed RAM lives directly in the save file
+        if (hasBattery()) {
+            mapSave(getSavePath(gameFile));
+        }
+        if (!ramMapped) {
+            saveData = new u8[saveSize];
+            std::memset(saveData, 0xFF, ramSize);
+            std::memset(saveData + ramSize, 0x00, saveSize - ramSize);
+        }
+        ramData = (ramSize > 0) ? saveData : nullptr;
+        clockData = hasClock() ? saveData + ramSize : nullptr;
+    }
+
     // Checksum verification: false if corrupted ROM
     if (!verifyChecksum()) {
         printf("Checksum verification failed.\n");
         return false;
     }
 
+    // The remaining checks read the whole ROM, so they run off the emulation thread. Real
+    // hardware ignores the global checksum, so a mismatch is only reported.
+    std::shared_ptr<const ROMImage> image = rom;
+    validation = std::async(std::launch::async, [image]() {
+        ROMValidation result = validate(image->getData(), image->getFileSize());
+        if (!result.globalChecksum) printf("Warning: global checksum mismatch.\n");
+        if (!result.logo) printf("Warning: boot logo mismatch.\n");
+        if (!result.size) printf("Warning: ROM size does not match the header.\n");
+        return result;
+    }).share();
+
     return true;
 }
 
+std::string Cartridge::getSavePath(std::string gameFile) {
+    size_t extension = gameFile.find_last_of('.');
+    size_t directory = gameFile.find_last_of('/');
+    if (extension == std::string::npos || (directory != std::string::npos && extension < directory)) {
+        return gameFile + ".sav";
+    }
+    return gameFile.substr(0, extension) + ".sav";
+}
+
+int Cartridge::getMapperType() {
+    return getMapperType(header.cartridgeType);
+}
+
+int Cartridge::getMapperType(u8 cartridgeType) {
+    switch (cartridgeType) {
+        case 0x01: case 0x02: case 0x03:
+            return MBC_1;
+        case 0x05: case 0x06:
+            return MBC_2;
+        case 0x0F: case 0x10: case 0x11: case 0x12: case 0x13:
+            return MBC_3;
+        case 0x19: case 0x1A: case 0x1B: case 0x1C: case 0x1D: case 0x1E:
+            return MBC_5;
+        default:
+            return MBC_NONE;
+    }
+}
+
+bool Cartridge::hasClock() {
+    return header.cartridgeType == 0x0F || header.cartridgeType == 0x10;
+}
+
+bool Cartridge::hasBattery() {
+    switch (header.cartridgeType) {
+        case 0x03: case 0x06: case 0x09: case 0x0D: case 0x0F: case 0x10:
+        case 0x13: case 0x1B: case 0x1E: case 0x22: case 0xFF:
+            return true;
+        default:
+            return false;
+    }
+}
+
+bool Cartridge::mapSave(std::string saveFile) {
+    int fd = open(saveFile.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        printf("Cannot open save file %s.\n", saveFile.c_str());
+        return false;
+    }
+
+    // Grow new or short save files to the full RAM size
+    struct stat fileInfo;
+    long existingSize = (fstat(fd, &fileInfo) == 0) ? fileInfo.st_size : 0;
+    if (existingSize < saveSize && ftruncate(fd, saveSize) != 0) {
+        printf("Cannot resize save file %s.\n", saveFile.c_str());
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, saveSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        printf("Cannot map save file %s.\n", saveFile.c_str());
+        return false;
+    }
+
+    saveData = (u8 *) mapping;
+    ramMapped = true;
+
+    // Uninitialised SRAM reads back as 0xFF, and a missing clock block starts from zero
+    if (existingSize < ramSize) {
+        std::memset(saveData + existingSize, 0xFF, ramSize - existingSize);
+    }
+    if (existingSize < saveSize && saveSize > ramSize) {
+        std::memset(saveData + ramSize, 0x00, saveSize - ramSize);
+    }
+    printf("Save file: %s\n", saveFile.c_str());
+    return true;
+}
+
+void Cartridge::syncSave(bool wait) {
+    if (ramMapped) {
+        msync(saveData, saveSize, wait ? MS_SYNC : MS_ASYNC);
+    }
+}
+
 long Cartridge::getFileSize(std::string gameFile) {
     long fileSize = std::filesystem::file_size(gameFile);
     return fileSize;
 }
 
-GBHeader Cartridge::getHeader(u8 *gameData) {
+GBHeader Cartridge::getHeader(const u8 *gameData) {
     GBHeader header;
     
     // Header offset values
@@ -67,17 +238,64 @@ GBHeader Cartridge::getHeader(u8 *gameData) {
     std::memcpy(header.title, gameData + titleOffset, 16);
     header.cartridgeType = gameData[cartridgeTypeOffset];
     header.licenseCode = gameData[licenseCodeOffset] | (gameData[licenseCodeOffset + 1] << 8);
+    header.romSizeCode = gameData[0x0148];
+    header.ramSizeCode = gameData[0x0149];
+    header.headerChecksum = gameData[0x014D];
+    header.globalChecksum = (gameData[0x014E] << 8) | gameData[0x014F];
 
     return header;
 }
 
-bool Cartridge::verifyChecksum() {
+u8 Cartridge::getHeaderChecksum(const u8 *gameData) {
     u8 checksum = 0;
     for (u16 address = 0x0134; address <= 0x014C; address++) {
         checksum = checksum - gameData[address] - 1;
     }
+    return checksum;
+}
+
+u16 Cartridge::getGlobalChecksum(const u8 *gameData, long size) {
+    u64 sum = sumBytes(gameData, size);
+    if (size >= 0x0150) {
+        sum -= gameData[0x014E] + gameData[0x014F];
+    }
+    return (u16) sum;
+}
+
+ROMValidation Cartridge::validate(const u8 *gameData, long size) {
+    ROMValidation result;
+    if (size < 0x0150) {
+        return result;
+    }
+    GBHeader header = getHeader(gameData);
+    result.headerChecksum = getHeaderChecksum(gameData) == header.headerChecksum;
+    result.globalChecksum = getGlobalChecksum(gameData, size) == header.globalChecksum;
+    result.logo = std::memcmp(gameData + 0x0104, logo, LOGO_SIZE) == 0;
+    result.size = header.romSizeCode <= 0x08 && size == (0x8000L << header.romSizeCode);
+    return result;
+}
+
+ROMValidation Cartridge::getValidation() {
+    if (!validation.valid()) {
+        return ROMValidation();
+    }
+    return validation.get();
+}
+
+bool Cartridge::verifyChecksum() {
     u8 storedChecksum = gameData[0x014D];
-    return checksum == storedChecksum;
+    return getHeaderChecksum(gameData) == storedChecksum;
+}
+
+long Cartridge::getRAMSize(u8 ramSizeCode) {
+    switch (ramSizeCode) {
+        case 0x01: return 0x800;
+        case 0x02: return 0x2000;
+        case 0x03: return 0x8000;
+        case 0x04: return 0x20000;
+        case 0x05: return 0x10000;
+        default: return 0;
+    }
 }
 
 u8 Cartridge::getMemory(u16 address) {
@@ -95,6 +313,31 @@ u8 *Cartridge::getGameData() {
     return gameData;
 }
 
+long Cartridge::getROMSize() {
+    return romSize;
+}
+
+u8 *Cartridge::getRAMData() {
+    return ramData;
+}
+
+long Cartridge::getRAMSize() {
+    return ramSize;
+}
+
+u8 *Cartridge::getClockData() {
+    return clockData;
+}
+
+const GBHeader &Cartridge::getCartridgeHeader() {
+    return header;
+}
+
 Cartridge::~Cartridge() {
-    delete[] gameData;
+    if (ramMapped) {
+        syncSave(true);
+        munmap(saveData, saveSize);
+    } else {
+        delete[] saveData;
+    }
 }
@@ -8,46 +8,76 @@
 #define CARTRIDGE_H
 
 #include <string>
+#include <memory>
+#include <future>
 #include "global.h"
+#include "ROMImage.h"
+
+#define ROM_BANK_SIZE 0x4000
+#define RAM_BANK_SIZE 0x2000
+#define MBC2_RAM_SIZE 0x200 ///< Built-in MBC2 RAM, 512 half-bytes.
+#define RTC_SAVE_SIZE 48    ///< MBC3 clock block appended to the save file.
+#define LOGO_SIZE 48        ///< Boot logo bitmap at 0x0104-0x0133.
+
+#define MBC_NONE 0
+#define MBC_1 1
+#define MBC_2 2
+#define MBC_3 3
+#define MBC_5 5
 
 /**
  * @brief A header struct. Contains the title of the ROM file,
- * the cartridge type, and the license code.
+ * the cartridge type, the license code and the memory sizes.
  */
 struct GBHeader
 {
     char title[16];
     u8 cartridgeType;
     u16 licenseCode;
+    u8 romSizeCode;     ///< ROM size code at 0x0148, 32 KB << code.
+    u8 ramSizeCode;     ///< External RAM size code at 0x0149.
+    u8 headerChecksum;  ///< Header checksum at 0x014D.
+    u16 globalChecksum; ///< Big-endian global checksum at 0x014E.
+};
+
+/**
+ * @brief Results of the full ROM validation run after loading.
+ */
+struct ROMValidation
+{
+    bool headerChecksum = false; ///< 0x014D matches the bytes at 0x0134-0x014C.
+    bool globalChecksum = false; ///< 0x014E matches the sum of every other byte of the ROM.
+    bool logo = false;           ///< 0x0104-0x0133 holds the logo the boot ROM checks.
+    bool size = false;           ///< The file is as large as the ROM size code declares.
 };
 
 class Cartridge
 {
 private:
-    u8 *gameData;  ///< Pointer to the ROM file data as an array of bytes.
+    std::shared_ptr<const ROMImage> rom; ///< ROM image shared with other cartridges loading the same file.
+    u8 *gameData;  ///< Pointer to the ROM file data as an array of bytes. Read-only.
     long fileSize; ///< Size of the ROM file in bytes.
+    long romSize;  ///< Size of gameData, padded to a whole number of 16 KB banks.
+    u8 *ramData;   ///< External cartridge RAM, nullptr if the cartridge has none.
+    long ramSize;  ///< Size of ramData in bytes.
+    u8 *clockData; ///< MBC3 clock block, nullptr if the cartridge has no clock.
+    u8 *saveData;  ///< External RAM followed by the clock block.
+    long saveSize; ///< Size of saveData in bytes.
+    bool ramMapped; ///< Whether saveData is a shared mapping of the battery save file.
+    GBHeader header; ///< Header of the loaded ROM file.
+    std::shared_future<ROMValidation> validation; ///< Full validation, run on a background thread.
 
     /**
-     * @brief Get the header values of the ROM file.
-     *
-     * @param gameData A pointer to the ROM file data.
-     * @return GBHeader, a struct containing the necessary header values
-     */
-    GBHeader getHeader(u8 *gameData);
-
-    /**
-     * @brief Get the size of the ROM file in bytes.
+     * @brief Maps external RAM onto a save file shared with the OS page cache, so every
+     * write the game makes is persisted without an explicit save.
      *
-     * @param gameFile A string containing the name of the ROM file.
-     * @return A long value representing the size of the ROM file in bytes.
+     * @param saveFile A string containing the name of the save file, created if missing.
+     * @return true if the save file was mapped, false if RAM must live on the heap instead.
      */
-    long getFileSize(std::string gameFile);
+    bool mapSave(std::string saveFile);
 
     /**
      * @brief Verifies the checksum of the ROM file to ensure the game files
-=======
-     * @brief Verifies the checksum of the ROM file to ensure the game files
->>>>>>> 11b6004329bdab6e6d80e106cc5e21d32024e9a5
      * are not corrupted.
      *
      * @return true if the checksum is valid, false if the checksum is invalid
@@ -80,6 +110,136 @@ public:
      */
     u8 *getGameData();
 
+    /**
+     * @brief Get the size of the ROM buffer, always a whole number of 16 KB banks.
+     *
+     * @return The size of the buffer returned by getGameData in bytes.
+     */
+    long getROMSize();
+
+    /**
+     * @brief Getter method for the external cartridge RAM.
+     *
+     * @return A pointer to the external RAM, or nullptr if the cartridge has none.
+     */
+    u8 *getRAMData();
+
+    /**
+     * @brief Get the size of the external cartridge RAM.
+     *
+     * @return The size of the buffer returned by getRAMData in bytes.
+     */
+    long getRAMSize();
+
+    /**
+     * @brief Getter method for the persisted MBC3 clock state.
+     *
+     * @return A pointer to the RTC_SAVE_SIZE byte clock block, or nullptr if the cartridge has no clock.
+     */
+    u8 *getClockData();
+
+    /**
+     * @brief Getter method for the parsed ROM header.
+     *
+     * @return The header of the loaded ROM file.
+     */
+    const GBHeader &getCartridgeHeader();
+
+    /**
+     * @brief Get the memory bank controller the cartridge type byte selects.
+     *
+     * @return int One of the MBC_* constants.
+     */
+    int getMapperType();
+
+    /**
+     * @brief Get the header values of a ROM image.
+     *
+     * @param gameData A pointer to at least 0x150 bytes of ROM data.
+     * @return GBHeader, a struct containing the necessary header values
+     */
+    static GBHeader getHeader(const u8 *gameData);
+
+    /**
+     * @brief Computes the header checksum over 0x0134-0x014C.
+     *
+     * @param gameData A pointer to at least 0x150 bytes of ROM data.
+     * @return The checksum the byte at 0x014D should hold.
+     */
+    static u8 getHeaderChecksum(const u8 *gameData);
+
+    /**
+     * @brief Computes the global checksum, the 16-bit sum of every ROM byte except 0x014E-0x014F.
+     *
+     * @param gameData A pointer to the ROM data.
+     * @param size Size of the ROM data in bytes.
+     * @return The checksum the big-endian word at 0x014E should hold.
+     */
+    static u16 getGlobalChecksum(const u8 *gameData, long size);
+
+    /**
+     * @brief Checks every field of a ROM that can be verified without running it.
+     *
+     * @param gameData A pointer to the ROM data.
+     * @param size Size of the ROM file in bytes.
+     * @return ROMValidation, one flag per check.
+     */
+    static ROMValidation validate(const u8 *gameData, long size);
+
+    static const u8 logo[LOGO_SIZE]; ///< Boot logo every licensed cartridge carries at 0x0104.
+
+    /**
+     * @brief Get the result of the full ROM validation, waiting for it if it is still running.
+     *
+     * @return ROMValidation, all false if no ROM was loaded.
+     */
+    ROMValidation getValidation();
+
+    /**
+     * @brief Get the memory bank controller a cartridge type byte selects.
+     *
+     * @param cartridgeType The byte at 0x0147 of the ROM header.
+     * @return int One of the MBC_* constants.
+     */
+    static int getMapperType(u8 cartridgeType);
+
+    /**
+     * @brief Get the external RAM size a header RAM size code declares.
+     *
+     * @param ramSizeCode The byte at 0x0149 of the ROM header.
+     * @return The RAM size in bytes, 0 for none.
+     */
+    static long getRAMSize(u8 ramSizeCode);
+
+    /**
+     * @brief Whether the cartridge type has an MBC3 real-time clock.
+     *
+     * @return true for MBC3+TIMER cartridges.
+     */
+    bool hasClock();
+
+    /**
+     * @brief Whether the cartridge type has battery-backed RAM.
+     *
+     * @return true if external RAM should persist between sessions.
+     */
+    bool hasBattery();
+
+    /**
+     * @brief Get the name of the save file belonging to a ROM file.
+     *
+     * @param gameFile A string containing the name of the ROM file.
+     * @return The ROM file name with its extension replaced by .sav.
+     */
+    static std::string getSavePath(std::string gameFile);
+
+    /**
+     * @brief Flushes battery-backed RAM to the save file.
+     *
+     * @param wait true to block until the data is on disk, false to only schedule the write.
+     */
+    void syncSave(bool wait);
+
     /**
      * @brief Gets a byte of memory at the specified address.
      *
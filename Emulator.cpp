@@ -1,13 +1,61 @@
 #include "Emulator.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <map>
+#include <mutex>
 
-Emulator::Emulator(const char *fileName): cartridge(fileName), mmu(&cartridge, fileName), cpu(&mmu) {
+/**
+ * @brief Machine state at the moment the boot ROM unmaps itself.
+ */
+struct BootSnapshot
+{
+    CPUState cpu;
+    std::vector<u8> memory;
+};
+
+static std::map<std::string, BootSnapshot> bootSnapshots; ///< Post-boot states, keyed by boot ROM and cartridge header
+static std::mutex bootSnapshotsLock;
+
+Emulator::Emulator(const char *fileName, const char *bootFile): cartridge(fileName), mmu(&cartridge), cpu(&mmu) {
     printf("Loading %s\n", fileName);
+    if (bootFile) {
+        startBoot(bootFile);
+    }
+    if (HEATMAP_FRAMES > 0) {
+        mmu.enableHeatmap(true);
+    }
     cpu.dumpRegisters();
     run();
 }
 
+void Emulator::startBoot(const char *bootFile) {
+    if (!mmu.loadBootROM(bootFile)) {
+        return;
+    }
+
+    // The boot ROM only reads the logo and header, so they decide the state it ends in
+    bootKey.assign((const char *) mmu.getBootROM(), BOOT_ROM_SIZE);
+    bootKey.append((const char *) cartridge.getGameData() + 0x0100, 0x50);
+
+    std::lock_guard<std::mutex> lock(bootSnapshotsLock);
+    auto snapshot = bootSnapshots.find(bootKey);
+    if (snapshot != bootSnapshots.end()) {
+        mmu.unmapBootROM();
+        mmu.loadRAM(snapshot->second.memory);
+        cpu.loadState(snapshot->second.cpu);
+        return;
+    }
+    cpu.startBootROM();
+    booting = true;
+}
+
+void Emulator::finishBoot() {
+    booting = false;
+    std::lock_guard<std::mutex> lock(bootSnapshotsLock);
+    bootSnapshots[bootKey] = {cpu.saveState(), mmu.saveRAM()};
+}
+
 void Emulator::run() {
     graphics = new Graphics(&mmu, &cpu);
     while (graphics->window.isOpen()) {
@@ -16,31 +64,58 @@ void Emulator::run() {
 }
 
 Emulator::~Emulator() {
+    PageArena::getInstance().report("Snapshot pages");
 }
 
 void Emulator::loop() {
     std::fstream logfile;
     logfile.open("log.txt", std::ios::out);
-    int cyclesPassed = 0;
-    while (cyclesPassed < CYCLES_PER_FRAME) {
-        u16 PC = cpu.getPC();
-        logfile <<"PC 0x" << std::hex << PC;
-
-        u8 opCode = cpu.getInstruction();
-        int cycles = cpu.executeInstruction(opCode);
-
-        // print opcode and cycles
-        printf("PC: 0x%04X OPCODE: %02X CYCLES: %d\n", PC, opCode, cycles);
-        logfile << " OPCODE: " << std::hex << (int)opCode << " CYCLES: " << cycles << "\n";
-
-        cpu.updateTimer(cycles);
-        cyclesPassed += cycles;
-        while (std::cin.get() != '\n');
-        graphics->updateArray(cycles);
-        handleInterrupts();
+    HotState *hot = mmu.getHotState();
+    u64 frameEnd = hot->cycles + CYCLES_PER_FRAME;
+    while (hot->cycles < frameEnd) {
+        // Run to the next event: the end of the frame, or of an OAM DMA, which starting one moves up
+        hot->nextEvent = mmu.isDMAActive() ? std::min(frameEnd, mmu.getDMAEnd()) : frameEnd;
+        while (hot->cycles < hot->nextEvent) {
+            u16 PC = cpu.getPC();
+            logfile <<"PC 0x" << std::hex << PC;
+
+            u8 opCode = cpu.fetchOpcode();
+            int cycles = cpu.executeInstruction(opCode);
+
+            // print opcode and cycles
+            printf("PC: 0x%04X OPCODE: %02X CYCLES: %d\n", PC, opCode, cycles);
+            logfile << " OPCODE: " << std::hex << (int)opCode << " CYCLES: " << cycles << "\n";
+
+            cpu.updateTimer(cycles);
+            if (booting && !mmu.isBootROMMapped()) {
+                finishBoot();
+            }
+            hot->cycles += cycles;
+            while (std::cin.get() != '\n');
+            graphics->updateArray(cycles);
+            handleInterrupts();
+        }
+        mmu.updateDMA();
     }
     graphics->updateDisplay();
     logfile.close();
+
+    // Export access counts once per window
+    Heatmap *heatmap = mmu.getHeatmap();
+    if (heatmap) {
+        heatmap->endFrame();
+        if (heatmap->getFrames() >= HEATMAP_FRAMES) {
+            heatmap->exportCSV("heatmap_" + std::to_string(heatmapWindow++) + ".csv");
+            heatmap->reset();
+        }
+    }
+
+    // Schedule a flush of battery-backed RAM; the OS writes it back off this thread
+    if (SAVE_SYNC_FRAMES > 0 && ++framesSinceSave >= SAVE_SYNC_FRAMES) {
+        mmu.saveClock();
+        cartridge.syncSave(false);
+        framesSinceSave = 0;
+    }
 }
 
 void Emulator::handleInterrupts() {
@@ -85,3 +160,24 @@ void Emulator::handleInterrupts() {
 u8 Emulator::readMemory(u16 addr) {
     return mmu.readByte(addr);
 }
+
+void Emulator::addWatchpoint(u16 addr, u8 type, WatchHandler handler, void *context) {
+    mmu.addWatchpoint(addr, type, handler, context);
+}
+
+void Emulator::removeWatchpoint(u16 addr, u8 type) {
+    mmu.removeWatchpoint(addr, type);
+}
+
+void Emulator::saveSnapshot(Snapshot &snapshot) {
+    snapshot.cpu = cpu.saveState();
+    mmu.takeSnapshot(snapshot.memory);
+}
+
+void Emulator::loadSnapshot(const Snapshot &snapshot) {
+    cpu.loadState(snapshot.cpu);
+    mmu.restoreSnapshot(snapshot.memory);
+    if (graphics) {
+        graphics->reloadPalettes();
+    }
+}
@@ -18,6 +18,17 @@
 
 #define FRAMES_PER_SECOND 60
 #define CYCLES_PER_FRAME CPU_CLOCK_SPEED / FRAMES_PER_SECOND
+#define SAVE_SYNC_FRAMES FRAMES_PER_SECOND ///< Frames between background flushes of the save file, 0 to only flush on exit
+#define HEATMAP_FRAMES 0 ///< Frames per exported memory access heatmap, 0 to disable access counting
+
+/**
+ * @brief A saved machine state. Memory pages unchanged between snapshots are shared, not copied.
+ */
+struct Snapshot
+{
+    CPUState cpu;          ///< CPU registers, timers and cycle count.
+    MemorySnapshot memory; ///< Guest RAM, bank registers, cartridge clock and DMA state.
+};
 
 class Emulator
 {
@@ -25,14 +36,30 @@ private:
     Cartridge cartridge; ///< Cartridge object
     MMU mmu;             ///< MMU object
     CPU cpu;             ///< CPU object
-    Graphics *graphics;  ///< Graphics object
+    Graphics *graphics = nullptr;  ///< Graphics object
+    int framesSinceSave = 0; ///< Frames emulated since the save file was last flushed
+    int heatmapWindow = 0;   ///< Number of heatmap windows exported so far
+    bool booting = false;    ///< Whether the boot ROM is running and its end state should be cached
+    std::string bootKey;     ///< Boot ROM image and cartridge header identifying the post-boot state
+
+    /**
+     * @brief Maps the boot ROM, or restores the cached state it produced for this cartridge.
+     * @param bootFile Name of the DMG boot ROM file.
+     */
+    void startBoot(const char *bootFile);
+
+    /**
+     * @brief Caches the post-boot state so later starts of the same cartridge can skip the boot ROM.
+     */
+    void finishBoot();
 
 public:
     /**
      * @brief Constructor for Emulator object
      * @param fileName name of the gameboy file to be run
+     * @param bootFile name of a DMG boot ROM to run first, or nullptr to start from the post-boot state
      */
-    Emulator(const char *fileName);
+    Emulator(const char *fileName, const char *bootFile = nullptr);
 
     /**
      * @brief Destroyer for the Emulator object
@@ -63,6 +90,34 @@ public:
      */
     u8 readMemory(u16 addr);
 
+    /**
+     * @brief Calls a handler whenever the given address is accessed, instead of polling it every frame.
+     * @param addr Memory address to watch.
+     * @param type Combination of WATCH_READ, WATCH_WRITE and WATCH_EXECUTE.
+     * @param handler Called for every matching access.
+     * @param context Object passed back to the handler.
+     */
+    void addWatchpoint(u16 addr, u8 type, WatchHandler handler, void *context);
+
+    /**
+     * @brief Stops watching an address.
+     * @param addr Memory address being watched.
+     * @param type Combination of WATCH_READ, WATCH_WRITE and WATCH_EXECUTE to remove.
+     */
+    void removeWatchpoint(u16 addr, u8 type);
+
+    /**
+     * @brief Saves the machine state. Only pages written since the previous snapshot are copied.
+     * @param snapshot Filled with the current state.
+     */
+    void saveSnapshot(Snapshot &snapshot);
+
+    /**
+     * @brief Rewinds the machine to a saved state. Only pages that differ from it are copied back.
+     * @param snapshot State returned by saveSnapshot.
+     */
+    void loadSnapshot(const Snapshot &snapshot);
+
     /**
      * @brief Main execution for the emulator
      * This function is responsible for running the selected Cartridge and CPU file
@@ -1,6 +1,8 @@
 #include "Graphics.h"
 #include <iostream>
 #include <bitset>
+#include <cstring>
+#include <algorithm>
 
 Graphics::Graphics(MMU* mmu, CPU* cpu) : window(sf::VideoMode(160, 144), "Gameboy Emulator") {
     this->cpu = cpu;
@@ -9,6 +11,34 @@ Graphics::Graphics(MMU* mmu, CPU* cpu) : window(sf::VideoMode(160, 144), "Gamebo
     texture.create(SCREEN_WIDTH, SCREEN_HEIGHT);
     sprite.setTexture(texture);
 
+    // Turning the LCD off resets LY
+    mmu->registerIOHandler(LCDC_ADDR, nullptr, [](void *context, u16 location, u8 data) {
+        Graphics *graphics = (Graphics *) context;
+        if (!(data & 0x80)) {
+            graphics->scanLineCounter = 0;
+            graphics->mmu->writeIO(LY_ADDR, 0);
+        }
+        graphics->mmu->writeIO(location, data);
+    }, this);
+    // The mode and coincidence bits of STAT are read-only
+    mmu->registerIOHandler(STAT_ADDR, [](void *context, u16 location) -> u8 {
+        return ((MMU *) context)->readIO(location) | 0x80;
+    }, [](void *context, u16 location, u8 data) {
+        MMU *mmu = (MMU *) context;
+        mmu->writeIO(location, (data & 0x78) | (mmu->readIO(location) & 0x07));
+    }, mmu);
+    // LY is driven by the PPU
+    mmu->registerIOHandler(LY_ADDR, nullptr, [](void *, u16, u8) {}, this);
+    // Palette writes rebuild the lookup table the renderer maps pixels through
+    for (u16 location : {BGP_ADDR, OBP0_ADDR, OBP1_ADDR}) {
+        mmu->registerIOHandler(location, nullptr, [](void *context, u16 location, u8 data) {
+            Graphics *graphics = (Graphics *) context;
+            graphics->palettes[location - BGP_ADDR].update(data);
+            graphics->mmu->writeIO(location, data);
+        }, this);
+    }
+    reloadPalettes();
+
     setInitialDisplay();
     run();
 }
@@ -82,9 +112,43 @@ void Graphics::setInitialDisplay() {
     u16 tileRow = (yPosition / 8) * 32;
 }
 
+void Graphics::updateTiles() {
+    std::bitset<TILE_COUNT> tiles = mmu->takeDirtyTiles();
+    if (tiles.any()) {
+        tileCache.update(mmu->getVRAM(), tiles);
+        gatheredLines.reset();
+    }
+
+    // A map row is read by the eight scanlines renderTiles draws from it, in either map
+    std::bitset<MAP_ROW_COUNT> rows = mmu->takeDirtyMapRows();
+    for (int row = 0; row < MAP_ROW_COUNT && rows.any(); row++) {
+        if (!rows[row]) {
+            continue;
+        }
+        rows.reset(row);
+        for (int line = (row % 32) * TILE_SIZE; line < ((row % 32) + 1) * TILE_SIZE && line < SCREEN_HEIGHT; line++) {
+            gatheredLines.reset(line);
+        }
+    }
+}
+
 void Graphics::renderTiles() {
-    std::vector<sf::Uint8> pixelBuffer(SCREEN_WIDTH * SCREEN_HEIGHT * 4, 255);
-    for (int pixel = 0; pixel < SCREEN_WIDTH; pixel++) {
+    updateTiles();
+    const u8 *vram = mmu->getVRAM();
+
+    // Unchanged scanlines keep the color indices gathered last time; only the palette is applied again
+    u8 *colors = colorBuffer[scanLineCounter];
+    u32 settings = scrollX | (windowX << 8) | (windowEnabled << 16) | (isUnsignedByte << 17) | ((backgroundMemory == 0x9C00) << 18);
+    if (gatheredLines[scanLineCounter] && lineSettings[scanLineCounter] == settings) {
+        PixelKernels::mapColors(colors, SCREEN_WIDTH, palettes[0].getColors(), frameBuffer + scanLineCounter * SCREEN_WIDTH);
+        return;
+    }
+    gatheredLines.set(scanLineCounter);
+    lineSettings[scanLineCounter] = settings;
+
+    // Gather the color indices for the scanline a tile row at a time, straight into its frame row
+    int tileRow = scanLineCounter % TILE_SIZE;
+    for (int pixel = 0; pixel < SCREEN_WIDTH;) {
         u8 xPosition = pixel + scrollX;
         if (windowEnabled) {
             if (pixel >= windowX) {
@@ -92,66 +156,22 @@ void Graphics::renderTiles() {
             }
         }
 
-        // Get tile address
+        // Get tile number; in signed mode tiles 0x80-0xFF come from 0x8800 and 0x00-0x7F from 0x9000
         u16 tileAddress = backgroundMemory + ((scanLineCounter / 8) * 32) + (xPosition / 8);
-        u16 tileNumber = mmu->readByte(tileAddress);
-        u16 tileLocation = startAddress;
-
-        if (isUnsignedByte) {
-            tileLocation += (tileNumber * 16);
-        } else {
-            tileLocation += ((tileNumber + 128) * 16);
-        }
-
-        // Note: each bit contains info for two adjacent pixels
-        u8 line = (scanLineCounter % 8) * 2;
-        u8 pixel1 = mmu->readByte(tileLocation + line);
-        u8 pixel2 = mmu->readByte(tileLocation + line + 1);
-
-        // Get pixel color
-        int colorBit = (xPosition % 8) - 1;
-        colorBit -= 7;
-        colorBit *= -1;
-
-        // Combine data to get color id for pixel
-        int colorNum = (pixel2 & (1 << colorBit)) >> colorBit;
-        colorNum <<= 1;
-        colorNum |= (pixel1 & (1 << colorBit)) >> colorBit;
-
-        switch(colorNum) {
-            // White
-            case 0:
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4] = 255;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 1] = 255;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 2] = 255;
-                break;
-
-            // Light grey
-            case 1:
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4] = 0xCC;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 1] = 0xCC;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 2] = 0xCC;
-                break;
-
-            // Dark grey
-            case 2:
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4] = 0x77;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 1] = 0x77;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 2] = 0x77;
-                break;
-            
-            // Black
-            case 3:
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4] = 0;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 1] = 0;
-                pixelBuffer[((line * SCREEN_WIDTH) + pixel) * 4 + 2] = 0;
-                break;
+        u8 tileNumber = vram[tileAddress - 0x8000];
+        int tile = isUnsignedByte ? tileNumber : 256 + (s8) tileNumber;
+
+        // Copy the rest of the tile row, stopping where the window or the screen ends
+        int start = xPosition % TILE_SIZE;
+        int count = std::min(TILE_SIZE - start, SCREEN_WIDTH - pixel);
+        if (windowEnabled && pixel < windowX) {
+            count = std::min(count, windowX - pixel);
         }
+        std::memcpy(colors + pixel, tileCache.getRow(tile, tileRow) + start, count);
+        pixel += count;
     }
 
-    // Update the texture with the entire pixelBuffer
-    texture.update(pixelBuffer.data());
-    // printf("Pixel buffer data: %d\n", pixelBuffer.data());
+    PixelKernels::mapColors(colors, SCREEN_WIDTH, palettes[0].getColors(), frameBuffer + scanLineCounter * SCREEN_WIDTH);
 }
 
 void Graphics::run() {
@@ -168,79 +188,56 @@ void Graphics::run() {
 }
 
 void Graphics::renderSprites() {
-    for (int sprite = 0; sprite < 40; sprite++) {
-        u8 index = sprite * 4;
-        u8 yPos = mmu->readByte(0xFE00 + index) - 16;
-        u8 xPos = mmu->readByte(0xFE00 + index + 1) - 8;
-        u8 tileLocation = mmu->readByte(0xFE00 + index + 2);
-        u8 attributes = mmu->readByte(0xFE00 + index + 3);
+    updateTiles();
+    if (mmu->takeOAMDirty() || spriteLists.getHeight() != spriteSize) {
+        spriteLists.build(mmu->getOAM(), spriteSize);
+    }
+
+    int scanLine = scanLineCounter;
+    const u8 *oam = mmu->getOAM();
+    const u8 *sprites = spriteLists.getSprites(scanLine);
+
+    // Draw from the lowest priority up, so higher priority sprites end up on top
+    for (int i = spriteLists.getCount(scanLine) - 1; i >= 0; i--) {
+        const u8 *entry = oam + sprites[i] * SPRITE_BYTES;
+        int yPos = entry[0] - 16;
+        int xPos = entry[1] - 8;
+        u8 tileLocation = entry[2];
+        u8 attributes = entry[3];
 
         bool yFlip = (attributes & (1 << 6)) != 0;
         bool xFlip = (attributes & (1 << 5)) != 0;
 
-        u8 scanLine = mmu->readByte(0xFF44);
+        // The list only holds sprites that intercept the scanline
+        int line = scanLine - yPos;
 
-        // Does sprite intercept with scanline?
-        if ((scanLine >= yPos) && (scanLine < (yPos + spriteSize))) {
-            int line = scanLine - yPos;
+        // Read sprite backwards if yFlip is set
+        if (yFlip) {
+            line = spriteSize - 1 - line;
+        }
 
-            // Read sprite backwards if yFlip is set
-            if (yFlip) {
-                line -= spriteSize;
-                line *= -1;
+        // 8x16 sprites ignore bit 0 of the tile number and continue into the next tile.
+        // The cache holds a mirrored copy of every row for xFlip.
+        if (spriteSize == 16) {
+            tileLocation &= 0xFE;
+        }
+        const u8 *row = tileCache.getRow(tileLocation + line / TILE_SIZE, line % TILE_SIZE, xFlip);
+
+        // Color 0 is transparent, and with bit 7 set the sprite only shows over background color 0
+        const u32 *palette = palettes[(attributes & 0x10) ? 2 : 1].getColors();
+        for (int tilePixel = 0; tilePixel < TILE_SIZE; tilePixel++) {
+            int x = xPos + tilePixel;
+            if (x < 0 || x >= SCREEN_WIDTH || row[tilePixel] == 0) {
+                continue;
             }
-
-            line *= 2;
-            u16 dataAddress = (0x8000 + (tileLocation * 16)) + line;
-            u8 data1 = mmu->readByte(dataAddress);
-            u8 data2 = mmu->readByte(dataAddress + 1);
-
-            for (int tilePixel = 7; tilePixel >= 0; tilePixel--) {
-                int colorBit = tilePixel;
-
-                // Read sprite backwards if xFlip is set
-                if (xFlip) {
-                    colorBit -= 7;
-                    colorBit *= -1;
-                }
-
-                int colorNum = (data2 & (1 << colorBit)) >> colorBit;
-                colorNum <<= 1;
-                colorNum |= (data1 & (1 << colorBit)) >> colorBit;
-
-                // Get color from palette
-                u8 color = getPixelColor(colorNum);
+            if ((attributes & 0x80) && colorBuffer[scanLine][x] != 0) {
+                continue;
             }
+            frameBuffer[scanLine * SCREEN_WIDTH + x] = (Pixel) palette[row[tilePixel]];
         }
     }
 }
 
-sf::Uint8 Graphics::getPixelColor(u8 pixelValue) {
-    switch (pixelValue) {
-        case 0:
-            return 00; // White
-        case 1:
-            return 01; // Light grey
-        case 2:
-            return 10; // Dark grey
-        default:
-            return 11;   //  Black
-    }
-}
-
-std::vector<sf::Uint8> Graphics::updateScanline() {
-    std::vector<sf::Uint8> scanline(SCREEN_WIDTH);
-
-    // for (int pixel = 0; pixel < SCREEN_WIDTH; pixel++) {
-    //     u16 offset = startAddress + pixel + (scanLineCounter - 1) * SCREEN_WIDTH;
-    //     scanline[pixel] = mmu->readByte(offset);
-    //     int color = getPixelColor(scanline[pixel]);
-    //     scanline[pixel] = (color << 16) | (color << 8) | color | (255 << 24); 
-    // }
-
-    // return scanline;
-}
-
 void Graphics::updateArray(int cycles) {
     cycleCounter += cycles;
     printf("Cycle counter: %d\n", cycleCounter);
@@ -265,14 +262,31 @@ void Graphics::updateArray(int cycles) {
         // Vdraw - update scanline array
         } else if (scanLineCounter < 144) {
             renderTiles();
+            if (mmu->readIO(LCDC_ADDR) & 0x02) {
+                renderSprites();
+            }
         }
+        mmu->writeIO(LY_ADDR, scanLineCounter);
     }
     return;
 }
 
+void Graphics::reloadPalettes() {
+    palettes[0].update(mmu->readIO(BGP_ADDR));
+    palettes[1].update(mmu->readIO(OBP0_ADDR));
+    palettes[2].update(mmu->readIO(OBP1_ADDR));
+}
+
+const Pixel *Graphics::getFrameBuffer() {
+    return frameBuffer;
+}
+
 void Graphics::updateDisplay() {
+    // The scanlines were drawn into the frame buffer as they completed; upload it once per frame
+#if PIXEL_FORMAT == PIXEL_RGBA8888
+    texture.update((const sf::Uint8 *) frameBuffer);
+#endif
     window.clear();
-    renderTiles();
     window.draw(sprite);
     window.display();
 }
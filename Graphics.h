@@ -4,6 +4,13 @@
 #include <SFML/Graphics.hpp>
 #include "MMU.h"
 #include "CPU.h"
+#include "TileCache.h"
+#include "Palette.h"
+#include "SpriteLists.h"
+
+#define LCDC_ADDR 0xFF40
+#define STAT_ADDR 0xFF41
+#define LY_ADDR 0xFF44
 
 class Graphics {
     public:
@@ -43,12 +50,24 @@ class Graphics {
          * @return std::vector<sf::Uint8> An array of pixels representing the scanline
          */
         void updateArray(int cycles);
+
+        /**
+         * @brief Rebuilds the palette tables from the palette registers, after they were restored without a write
+         */
+        void reloadPalettes();
+
+        /**
+         * @brief Getter method for the frame buffer
+         *
+         * @return const Pixel* SCREEN_WIDTH * SCREEN_HEIGHT pixels in PIXEL_FORMAT, one row per scanline
+         */
+        const Pixel *getFrameBuffer();
         sf::RenderWindow window; ///< The window of the emulator
 
     private:
         int spriteSize; ///< The size of the sprites, either 8x8 or 8x16
-        int cycleCounter; ///< The number of cycles that have passed since the last update
-        int scanLineCounter; ///< The current scanline
+        int cycleCounter = 0; ///< The number of cycles that have passed since the last update
+        int scanLineCounter = 0; ///< The current scanline
         u8 scrollX; ///< The x position of the scroll
         u8 scrollY; ///< The y position of the scroll
         u8 windowX; ///< The x position of the window
@@ -57,40 +76,39 @@ class Graphics {
         bool isUnsignedByte; ///< Whether the tile data is signed or unsigned
         u16 startAddress; ///< The start address of the tile data
         u16 backgroundMemory; ///< The start address of the background memory
-        const int SCREEN_WIDTH = 160; ///< The width of the screen
-        const int SCREEN_HEIGHT = 144; ///< The height of the screen
+        static const int SCREEN_WIDTH = 160; ///< The width of the screen
+        static const int SCREEN_HEIGHT = 144; ///< The height of the screen
+        u8 colorBuffer[SCREEN_HEIGHT][SCREEN_WIDTH] = {}; ///< Color indices of the frame being drawn, one row per scanline
+        std::bitset<SCREEN_HEIGHT> gatheredLines; ///< Scanlines whose colorBuffer row still matches the tiles and map they came from
+        u32 lineSettings[SCREEN_HEIGHT] = {}; ///< Scroll, window and tile settings each colorBuffer row was gathered with
+        Pixel frameBuffer[SCREEN_HEIGHT * SCREEN_WIDTH] = {}; ///< Pixels of the frame in PIXEL_FORMAT, uploaded to the texture once per frame
+        Palette palettes[3]; ///< Lookup tables for BGP, OBP0 and OBP1, rebuilt when the registers are written
+        SpriteLists spriteLists; ///< Sprites on each scanline, rebuilt when OAM or the sprite size changes
         sf::Texture texture; ///< The texture of the emulator
         sf::Sprite sprite; ///< The sprite of the emulator
         CPU* cpu; ///< A pointer to the CPU object
         MMU* mmu; ///< A pointer to the MMU object
+        TileCache tileCache; ///< Decoded tile data, refreshed from the VRAM tiles written since the last render
 
         /**
-         * @brief Get the Pixel color
-         * 
-         * @param pixelValue An u8 value representing the pixel
-         * @return sf::Uint8 The pixel color (white, light grey, dark grey, black)
-         */
-        sf::Uint8 getPixelColor(u8 pixelValue);
-
-        /**
-         * @brief A function to update the scanline array
-         * 
-         * @return std::vector<sf::Uint8> The updated scanline array
+         * @brief Set the Initial Display based on the settings specified in the LCD Control Register
          */
-        std::vector<sf::Uint8> updateScanline();
+        void setInitialDisplay();
 
         /**
-         * @brief Set the Initial Display based on the settings specified in the LCD Control Register
+         * @brief Decodes the tiles written since the last render, and forgets the gathered scanlines
+         * that a changed tile or background map row could affect
          */
-        void setInitialDisplay();
+        void updateTiles();
 
         /**
-         * @brief Calculating the tile of the background graphics
+         * @brief Draws the background and window of the current scanline into its row of the frame buffer.
+         * The tile rows are only gathered again if the scanline's map row, a tile or the settings changed.
          */
         void renderTiles();
 
         /**
-         * @brief Calculates the position, display, and color of the sprite graphics
+         * @brief Draws the sprites on the current scanline over its row of the frame buffer
          */
         void renderSprites();
 };
@@ -0,0 +1,147 @@
+#include "Heatmap.h"
+#include <cstdio>
+#include <algorithm>
+
+/**
+ * @brief One non-zero counter, ready to export.
+ */
+struct HeatmapRow
+{
+    const char *region;
+    int bank;
+    u16 address;
+    AccessCount count;
+};
+
+/**
+ * @brief Get the name of the memory region containing an unbanked page.
+ */
+static const char *getRegion(u8 page) {
+    if (page < 0xA0) return "vram";
+    if (page < 0xC0) return "sram";
+    if (page < 0xE0) return "wram";
+    if (page < 0xFE) return "echo";
+    return "oam";
+}
+
+/**
+ * @brief Collects the non-zero counters in address order.
+ */
+static std::vector<HeatmapRow> getRows(const std::vector<AccessCount> &romPages, const std::vector<AccessCount> &ramPages,
+                                       const AccessCount *pages, const AccessCount *registers) {
+    std::vector<HeatmapRow> rows;
+    size_t windowSize = romPages.size() / 2;
+    for (size_t i = 0; i < romPages.size(); i++) {
+        // Banks switched into 0x0000 (MBC1 advanced mode) are reported at the window they were read through
+        int bank = (i % windowSize) / 0x40;
+        u16 address = ((i < windowSize) ? 0x0000 : 0x4000) + ((i % 0x40) << 8);
+        if (romPages[i].reads || romPages[i].writes) {
+            rows.push_back({"rom", bank, address, romPages[i]});
+        }
+    }
+    for (int page = 0x80; page < 0xFF; page++) {
+        if (page == 0xA0) {
+            for (size_t i = 0; i < ramPages.size(); i++) {
+                if (ramPages[i].reads || ramPages[i].writes) {
+                    rows.push_back({"sram", (int) (i / 0x20), (u16) (0xA000 + ((i % 0x20) << 8)), ramPages[i]});
+                }
+            }
+        }
+        if (pages[page].reads || pages[page].writes) {
+            // Accesses while cartridge RAM was disabled or a clock register was selected have no bank
+            int bank = (page >= 0xA0 && page < 0xC0) ? -1 : 0;
+            rows.push_back({getRegion(page), bank, (u16) (page << 8), pages[page]});
+        }
+    }
+    for (int reg = 0; reg < 0x100; reg++) {
+        if (registers[reg].reads || registers[reg].writes) {
+            const char *region = (reg >= 0x80 && reg < 0xFF) ? "hram" : "io";
+            rows.push_back({region, 0, (u16) (0xFF00 + reg), registers[reg]});
+        }
+    }
+    return rows;
+}
+
+Heatmap::Heatmap(int romBankCount, int ramBankCount) {
+    romPages.resize(2 * romBankCount * 0x40);
+    ramPages.resize(ramBankCount * 0x20);
+}
+
+AccessCount &Heatmap::getPage(u8 page, int bank) {
+    if (page < 0x80) {
+        int window = page >> 6;
+        return romPages[(window * (romPages.size() / 0x80) + bank) * 0x40 + (page & 0x3F)];
+    }
+    if (page >= 0xA0 && page < 0xC0 && bank >= 0 && !ramPages.empty()) {
+        return ramPages[bank * 0x20 + (page & 0x1F)];
+    }
+    return pages[page];
+}
+
+void Heatmap::recordRead(u16 location, int bank) {
+    if (location >= 0xFF00) {
+        registers[location & 0xFF].reads++;
+    } else {
+        getPage(location >> 8, bank).reads++;
+    }
+}
+
+void Heatmap::recordWrite(u16 location, int bank) {
+    if (location >= 0xFF00) {
+        registers[location & 0xFF].writes++;
+    } else {
+        getPage(location >> 8, bank).writes++;
+    }
+}
+
+void Heatmap::endFrame() {
+    frames++;
+}
+
+int Heatmap::getFrames() {
+    return frames;
+}
+
+void Heatmap::reset() {
+    std::fill(romPages.begin(), romPages.end(), AccessCount());
+    std::fill(ramPages.begin(), ramPages.end(), AccessCount());
+    std::fill(pages, pages + 0x100, AccessCount());
+    std::fill(registers, registers + 0x100, AccessCount());
+    frames = 0;
+}
+
+bool Heatmap::exportCSV(std::string fileName) {
+    FILE *fp = fopen(fileName.c_str(), "w");
+    if (!fp) {
+        printf("Cannot open heatmap file %s.\n", fileName.c_str());
+        return false;
+    }
+
+    fprintf(fp, "region,bank,address,reads,writes\n");
+    for (const HeatmapRow &row : getRows(romPages, ramPages, pages, registers)) {
+        fprintf(fp, "%s,%d,0x%04X,%llu,%llu\n", row.region, row.bank, row.address,
+                (unsigned long long) row.count.reads, (unsigned long long) row.count.writes);
+    }
+    fclose(fp);
+    return true;
+}
+
+bool Heatmap::exportJSON(std::string fileName) {
+    FILE *fp = fopen(fileName.c_str(), "w");
+    if (!fp) {
+        printf("Cannot open heatmap file %s.\n", fileName.c_str());
+        return false;
+    }
+
+    fprintf(fp, "{\"frames\": %d, \"accesses\": [", frames);
+    const char *separator = "\n";
+    for (const HeatmapRow &row : getRows(romPages, ramPages, pages, registers)) {
+        fprintf(fp, "%s  {\"region\": \"%s\", \"bank\": %d, \"address\": \"0x%04X\", \"reads\": %llu, \"writes\": %llu}",
+                separator, row.region, row.bank, row.address,
+                (unsigned long long) row.count.reads, (unsigned long long) row.count.writes);
+        separator = ",\n";
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+    return true;
+}
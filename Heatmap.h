@@ -0,0 +1,102 @@
+/**
+ * @class Heatmap
+ * @brief Guest memory access counters
+ * This class counts reads and writes per 256-byte guest page and per I/O register. Page counts
+ * are split by the bank mapped behind the page and, for ROM, by the CPU window it was read
+ * through. Counts cover a window of frames and can be exported as CSV or JSON to find the
+ * registers and polling loops a title hammers.
+ */
+#ifndef HEATMAP_H
+#define HEATMAP_H
+
+#include <string>
+#include <vector>
+#include "global.h"
+
+/**
+ * @brief Read and write counts for one page or register.
+ */
+struct AccessCount
+{
+    u64 reads = 0;
+    u64 writes = 0;
+};
+
+class Heatmap
+{
+private:
+    std::vector<AccessCount> romPages; ///< Indexed by (window * bank count + ROM bank) * 0x40 + page within the bank.
+    std::vector<AccessCount> ramPages; ///< Indexed by RAM bank * 0x20 + page within the bank.
+    AccessCount pages[0x100];          ///< Unbanked pages and unmapped cartridge RAM, indexed by page.
+    AccessCount registers[0x100];      ///< 0xFF00-0xFFFF, indexed by the low address byte.
+    int frames = 0;                    ///< Frames in the current window.
+
+    /**
+     * @brief Get the counter for a page.
+     *
+     * @param page The page (high byte of the address).
+     * @param bank The bank mapped behind the page, -1 if cartridge RAM is not mapped.
+     * @return AccessCount& The counter to update.
+     */
+    AccessCount &getPage(u8 page, int bank);
+
+public:
+    /**
+     * @brief Construct a new Heatmap object with counters for every bank.
+     *
+     * @param romBankCount Number of 16 KB ROM banks.
+     * @param ramBankCount Number of 8 KB RAM banks.
+     */
+    Heatmap(int romBankCount, int ramBankCount);
+
+    /**
+     * @brief Counts a read.
+     *
+     * @param location The guest address read.
+     * @param bank The bank mapped behind the address, -1 if cartridge RAM is not mapped.
+     */
+    void recordRead(u16 location, int bank);
+
+    /**
+     * @brief Counts a write.
+     *
+     * @param location The guest address written.
+     * @param bank The bank mapped behind the address, -1 if cartridge RAM is not mapped.
+     */
+    void recordWrite(u16 location, int bank);
+
+    /**
+     * @brief Marks the end of a frame in the current window.
+     */
+    void endFrame();
+
+    /**
+     * @brief Get the number of frames in the current window.
+     *
+     * @return int Frames counted since the last reset.
+     */
+    int getFrames();
+
+    /**
+     * @brief Clears all counters and starts a new window.
+     */
+    void reset();
+
+    /**
+     * @brief Writes the non-zero counters as CSV rows of region, bank, address, reads and writes.
+     *
+     * @param fileName Name of the file to create.
+     * @return true if the file was written.
+     */
+    bool exportCSV(std::string fileName);
+
+    /**
+     * @brief Writes the non-zero counters as a JSON object.
+     *
+     * @param fileName Name of the file to create.
+     * @return true if the file was written.
+     */
+    bool exportJSON(std::string fileName);
+};
+
+#endif
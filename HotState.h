@@ -0,0 +1,36 @@
+#ifndef HOTSTATE_H_INCLUDED
+#define HOTSTATE_H_INCLUDED
+
+#include <type_traits>
+#include "global.h"
+#include "Register.h"
+
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief The state touched on every instruction, packed into as few cache lines as possible.
+ * The first line holds the CPU registers, timer counters and cycle count; the I/O registers
+ * (timer, IF, PPU), HRAM and IE follow in address order. Owned by the MMU, which stores the
+ * 0xFF00-0xFFFF page here, and shared with the CPU. Trivially copyable, so a snapshot is a memcpy.
+ */
+struct alignas(CACHE_LINE_SIZE) HotState
+{
+    Register AF;            ///< `A` and `F` register pair (Accumulator and Flag registers).
+    Register BC;            ///< `B` and `C` register pair.
+    Register DE;            ///< `D` and `E` register pair.
+    Register HL;            ///< `H` and `L` register pair.
+    Register SP;            ///< Stack Pointer.
+    Register PC;            ///< Program Counter.
+    bool IME;               ///< Interrupt Master Enable flag.
+    int divCounter;         ///< CPU cycles counted towards the next DIV increment.
+    int timerCounter;       ///< CPU cycles counted towards the next TIMA increment.
+    u64 cycles;             ///< M-cycles emulated since power on.
+    u64 nextEvent;          ///< Cycle count at which the main loop next has to stop: the end of the frame or of an OAM DMA.
+
+    alignas(CACHE_LINE_SIZE) u8 io[0x100]; ///< 0xFF00-0xFFFF: I/O registers, HRAM and IE, indexed by the low address byte.
+};
+
+static_assert(std::is_trivially_copyable<HotState>::value, "HotState must be copyable with memcpy");
+static_assert(sizeof(HotState) == 5 * CACHE_LINE_SIZE, "CPU state must fit in one cache line before the I/O page");
+
+#endif
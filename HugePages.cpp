@@ -0,0 +1,103 @@
+#include "HugePages.h"
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <sys/mman.h>
+
+/**
+ * @brief Rounds a size up to whole huge pages.
+ */
+static size_t roundUp(size_t size) {
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+u8 *HugePages::allocate(size_t size) {
+    if (size < HUGE_PAGE_SIZE) {
+        void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return (mapping == MAP_FAILED) ? nullptr : (u8 *) mapping;
+    }
+
+    // Over-allocate by one huge page, then trim both ends so the buffer starts on a huge page boundary
+    size_t alignedSize = roundUp(size);
+    size_t mappedSize = alignedSize + HUGE_PAGE_SIZE;
+    void *mapping = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+    uintptr_t start = (uintptr_t) mapping;
+    uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (aligned > start) {
+        munmap(mapping, aligned - start);
+    }
+    size_t tail = (start + mappedSize) - (aligned + alignedSize);
+    if (tail > 0) {
+        munmap((void *) (aligned + alignedSize), tail);
+    }
+    advise((void *) aligned, alignedSize);
+    return (u8 *) aligned;
+}
+
+void HugePages::release(u8 *data, size_t size) {
+    if (data) {
+        munmap(data, (size < HUGE_PAGE_SIZE) ? size : roundUp(size));
+    }
+}
+
+bool HugePages::advise(void *data, size_t size) {
+#ifdef MADV_HUGEPAGE
+    // Only whole huge pages inside the range can be promoted
+    uintptr_t start = ((uintptr_t) data + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    uintptr_t end = ((uintptr_t) data + size) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    if (end <= start) {
+        return false;
+    }
+    return madvise((void *) start, end - start, MADV_HUGEPAGE) == 0;
+#else
+    return false;
+#endif
+}
+
+size_t HugePages::getGrantedBytes(void *data, size_t size) {
+    FILE *fp = fopen("/proc/self/smaps", "r");
+    if (!fp) {
+        return 0;
+    }
+
+    // Sum the huge page fields of each mapping overlapping the range, capped at the overlap
+    uintptr_t first = (uintptr_t) data;
+    uintptr_t last = first + size;
+    size_t overlap = 0;
+    size_t mappingGranted = 0;
+    size_t granted = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), fp)) {
+        unsigned long start, end;
+        char field[64];
+        unsigned long kilobytes;
+        if (sscanf(line, "%lx-%lx ", &start, &end) == 2) {
+            granted += std::min(mappingGranted, overlap);
+            mappingGranted = 0;
+            overlap = (start < last && end > first) ? std::min<uintptr_t>(end, last) - std::max<uintptr_t>(start, first) : 0;
+        } else if (overlap > 0 && sscanf(line, "%63s %lu kB", field, &kilobytes) == 2) {
+            if (!strcmp(field, "AnonHugePages:") || !strcmp(field, "FilePmdMapped:") || !strcmp(field, "ShmemPmdMapped:")) {
+                mappingGranted += kilobytes * 1024;
+            }
+        }
+    }
+    granted += std::min(mappingGranted, overlap);
+    fclose(fp);
+    return granted;
+}
+
+void HugePages::report(const char *name, void *data, size_t size) {
+    if (size < HUGE_PAGE_SIZE) {
+        return;
+    }
+    size_t granted = getGrantedBytes(data, size);
+    if (granted == 0) {
+        printf("%s: no huge pages granted, using normal pages.\n", name);
+        return;
+    }
+    printf("%s: %zu of %zu KB backed by huge pages.\n", name, granted / 1024, size / 1024);
+}
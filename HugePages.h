@@ -0,0 +1,65 @@
+/**
+ * @class HugePages
+ * @brief Transparent huge page backing for large buffers
+ * Large ROM images and snapshot storage are touched at random, so with 4 KB pages every bank
+ * switch or page copy risks a TLB miss. These helpers allocate or advise memory for 2 MB
+ * transparent huge pages, fall back to normal pages when the kernel refuses, and report how
+ * much the kernel actually granted.
+ */
+#ifndef HUGEPAGES_H
+#define HUGEPAGES_H
+
+#include <cstddef>
+#include "global.h"
+
+#define HUGE_PAGE_SIZE 0x200000
+
+class HugePages
+{
+public:
+    /**
+     * @brief Allocates zeroed anonymous memory, aligned to and advised for huge pages when it
+     * spans at least one.
+     *
+     * @param size Number of bytes.
+     * @return u8* The memory, or nullptr if it could not be mapped.
+     */
+    static u8 *allocate(size_t size);
+
+    /**
+     * @brief Frees memory returned by allocate.
+     *
+     * @param data The memory.
+     * @param size The size passed to allocate.
+     */
+    static void release(u8 *data, size_t size);
+
+    /**
+     * @brief Asks the kernel to back the huge-page-aligned part of a mapping with huge pages.
+     *
+     * @param data Start of the mapping.
+     * @param size Size of the mapping in bytes.
+     * @return true if the advice was accepted, false if the range is too small or huge pages are unavailable.
+     */
+    static bool advise(void *data, size_t size);
+
+    /**
+     * @brief Get how much of a range the kernel currently backs with huge pages.
+     *
+     * @param data Start of the range.
+     * @param size Size of the range in bytes.
+     * @return size_t Bytes backed by huge pages, 0 if unknown.
+     */
+    static size_t getGrantedBytes(void *data, size_t size);
+
+    /**
+     * @brief Prints how much of a buffer is backed by huge pages.
+     *
+     * @param name Name of the buffer.
+     * @param data Start of the buffer.
+     * @param size Size of the buffer in bytes.
+     */
+    static void report(const char *name, void *data, size_t size);
+};
+
+#endif
@@ -16,6 +16,22 @@ Input::Input(MMU& mmu) : mmu(mmu){
     directionKeyMappings['w'] = 2; // Up
     directionKeyMappings['s'] = 3; // Down
     directionKeyMappings['d'] = 0; // Right
+
+    // Bits 4 and 5 of JOYP select which key group is visible in the lower nibble
+    mmu.registerIOHandler(JOYP_ADDR, [](void *context, u16 location) -> u8 {
+        Input *input = (Input *) context;
+        u8 select = input->mmu.readIO(location) & 0x30;
+        u8 keys = 0x0F;
+        if (!(select & 0x10)) {
+            keys &= input->getDirectionKeysState();
+        }
+        if (!(select & 0x20)) {
+            keys &= input->getButtonKeysState();
+        }
+        return 0xC0 | select | keys;
+    }, [](void *context, u16 location, u8 data) {
+        ((Input *) context)->mmu.writeIO(location, data & 0x30);
+    }, this);
 }
 
 void Input::pressKey(char key) {
@@ -23,9 +39,7 @@ void Input::pressKey(char key) {
         buttonKeys.reset(buttonKeyMappings[key]);
     } 
     
-    // "Select" button must be pressed while reading keys from the lower nibble
     else if (directionKeyMappings.find(key) != directionKeyMappings.end()) {
-        buttonKeys.reset(buttonKeyMappings[' ']);
         directionKeys.reset(directionKeyMappings[key]);
     }
 
@@ -37,11 +51,8 @@ void Input::releaseKey(char key) {
     } 
     
     else if (directionKeyMappings.find(key) != directionKeyMappings.end()) {
-        buttonKeys.set(buttonKeyMappings[' ']);
         directionKeys.set(directionKeyMappings[key]);
     }
-
-    updateJoypadRegister();
 }
 
 u8 Input::getButtonKeysState() {
@@ -53,7 +64,8 @@ u8 Input::getDirectionKeysState() {
 }
 
 void Input::updateJoypadRegister() {
-    mmu.writeByte(0xFF00, (getDirectionKeysState() << 4) | getButtonKeysState());
+    // JOYP is computed when read, only the joypad interrupt needs raising
+    mmu.requestInterrupt(0x10);
 }
 
 Input::~Input() {
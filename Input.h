@@ -7,6 +7,8 @@
 #include <unordered_map>
 #include <iostream>
 
+#define JOYP_ADDR 0xFF00
+
 class Input {
 private:
     MMU& mmu; ///< Reference to the MMU object
@@ -16,7 +18,7 @@ private:
     std::unordered_map<char, int> directionKeyMappings; ///< Maps keyboard keys to direction keys
 
     /**
-     * @brief Updates the joypad register with the current state of the button and direction keys
+     * @brief Signals the CPU that a key was pressed. The joypad register itself is computed on read.
      */
     void updateJoypadRegister();
 
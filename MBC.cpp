@@ -0,0 +1,217 @@
+#include "MBC.h"
+#include "MMU.h"
+#include <algorithm>
+
+MBC::MBC(MMU *mmu, Cartridge *cartridge) {
+    this->mmu = mmu;
+    rom = cartridge->getGameData();
+    // A cartridge whose ROM failed to load has no banks; keep one so bank numbers stay defined
+    romBankCount = std::max(1L, cartridge->getROMSize() / ROM_BANK_SIZE);
+    ram = cartridge->getRAMData();
+    ramBankCount = cartridge->getRAMSize() / RAM_BANK_SIZE;
+    type = cartridge->getMapperType();
+    if (cartridge->getClockData()) {
+        rtc.reset(new RTC(cartridge->getClockData(), RTC_MODE));
+    }
+
+    // Pick the control decoder and bank mapping compiled for this mapper
+    switch (type) {
+        case MBC_1: useMapper<MBC_1>(); break;
+        case MBC_2: useMapper<MBC_2>(); break;
+        case MBC_3: useMapper<MBC_3>(); break;
+        case MBC_5: useMapper<MBC_5>(); break;
+        default: useMapper<MBC_NONE>(); break;
+    }
+
+    // Cartridges without a controller have their RAM permanently enabled
+    ramEnabled = (type == MBC_NONE);
+    (this->*mapBanks)(true);
+}
+
+template <int Type>
+void MBC::useMapper() {
+    decodeControl = &MBC::writeControl<Type>;
+    mapBanks = &MBC::updateMapping<Type>;
+}
+
+void MBC::writeControl(u16 location, u8 data) {
+    (this->*decodeControl)(location, data);
+}
+
+template <int Type>
+void MBC::writeControl(u16 location, u8 data) {
+    if constexpr (Type == MBC_NONE) {
+        return;
+    }
+    if constexpr (Type == MBC_1) {
+        if (location < 0x2000) {
+            ramEnabled = (data & 0x0F) == 0x0A;
+        } else if (location < 0x4000) {
+            romBank = data & 0x1F;
+            if (romBank == 0) {
+                romBank = 1;
+            }
+        } else if (location < 0x6000) {
+            ramBank = data & 0x03;
+        } else {
+            advancedMode = data & 0x01;
+        }
+    }
+    if constexpr (Type == MBC_2) {
+        // Address bit 8 selects between the RAM enable and ROM bank registers
+        if (location >= 0x4000) {
+            return;
+        }
+        if (location & 0x0100) {
+            romBank = data & 0x0F;
+            if (romBank == 0) {
+                romBank = 1;
+            }
+        } else {
+            ramEnabled = (data & 0x0F) == 0x0A;
+        }
+    }
+    if constexpr (Type == MBC_3) {
+        if (location < 0x2000) {
+            ramEnabled = (data & 0x0F) == 0x0A;
+        } else if (location < 0x4000) {
+            romBank = data & 0x7F;
+            if (romBank == 0) {
+                romBank = 1;
+            }
+        } else if (location < 0x6000) {
+            ramBank = data & 0x0F;
+        } else if (rtc) {
+            rtc->writeLatch(data);
+            return;
+        }
+    }
+    if constexpr (Type == MBC_5) {
+        if (location < 0x2000) {
+            ramEnabled = (data & 0x0F) == 0x0A;
+        } else if (location < 0x3000) {
+            romBank = (romBank & 0x100) | data;
+        } else if (location < 0x4000) {
+            romBank = (romBank & 0xFF) | ((data & 0x01) << 8);
+        } else if (location < 0x6000) {
+            ramBank = data & 0x0F;
+        }
+    }
+    updateMapping<Type>(false);
+}
+
+template <int Type>
+void MBC::updateMapping(bool remapAll) {
+    int lowerBank = 0;
+    int upperBank = romBank;
+    int selectedRAMBank = ramBank;
+
+    if constexpr (Type == MBC_1) {
+        upperBank = (ramBank << 5) | romBank;
+        if (advancedMode) {
+            lowerBank = ramBank << 5;
+        } else {
+            selectedRAMBank = 0;
+        }
+    }
+
+    // Disabled RAM and MBC3 clock registers (banks 0x08-0x0C) have no bank and go through the slow path
+    int banks[3] = {lowerBank % romBankCount, upperBank % romBankCount, -1};
+    if constexpr (Type == MBC_2) {
+        banks[2] = (ram && ramEnabled) ? 0 : -1;
+    } else if (ram && ramEnabled && selectedRAMBank < 0x08) {
+        banks[2] = selectedRAMBank % ramBankCount;
+    }
+
+    // Point the ROM pages straight into the cartridge buffer, repointing only the 16 KB windows
+    // whose bank changed
+    for (int window = 0; window < 2; window++) {
+        if (remapAll || banks[window] != mappedBanks[window]) {
+            mappedBanks[window] = banks[window];
+            mmu->mapReadPages(window * 0x40, 0x40, rom ? rom + banks[window] * ROM_BANK_SIZE : nullptr);
+        }
+    }
+    if (!remapAll && banks[2] == mappedBanks[2]) {
+        return;
+    }
+    mappedBanks[2] = banks[2];
+
+    if constexpr (Type == MBC_2) {
+        // The 512 half-bytes of built-in RAM repeat through 0xA000-0xBFFF. Writes take the
+        // slow path so the unused upper nibble always reads back as 1s.
+        u8 *ramBase = (banks[2] >= 0) ? ram : nullptr;
+        for (int page = 0xA0; page < 0xC0; page += MBC2_RAM_SIZE >> 8) {
+            mmu->mapReadPages(page, MBC2_RAM_SIZE >> 8, ramBase);
+        }
+        mmu->mapWritePages(0xA0, 0x20, nullptr);
+        return;
+    }
+
+    u8 *ramBase = (banks[2] >= 0) ? ram + banks[2] * RAM_BANK_SIZE : nullptr;
+    mmu->mapReadPages(0xA0, 0x20, ramBase);
+    mmu->mapWritePages(0xA0, 0x20, ramBase);
+}
+
+long MBC::writeRAM(u16 location, u8 data) {
+    if (type == MBC_2 && ram && ramEnabled) {
+        long offset = location & (MBC2_RAM_SIZE - 1);
+        ram[offset] = data | 0xF0;
+        return offset;
+    }
+    if (rtc && ramEnabled && ramBank >= RTC_SECONDS && ramBank <= RTC_DAYS_HIGH) {
+        rtc->writeRegister(ramBank, data);
+    }
+    return -1;
+}
+
+u8 MBC::readRAM(u16) {
+    if (rtc && ramEnabled && ramBank >= RTC_SECONDS && ramBank <= RTC_DAYS_HIGH) {
+        return rtc->readRegister(ramBank);
+    }
+    return 0xFF;
+}
+
+void MBC::setCycleCounter(const u64 *cycleCounter) {
+    if (rtc) {
+        rtc->setCycleCounter(cycleCounter);
+    }
+}
+
+void MBC::saveClock() {
+    if (rtc) {
+        rtc->save();
+    }
+}
+
+int MBC::getBank(u8 page) {
+    if (page < 0x80) {
+        return mappedBanks[page >> 6];
+    }
+    if (page >= 0xA0 && page < 0xC0) {
+        return mappedBanks[2];
+    }
+    return 0;
+}
+
+MBCState MBC::saveState() {
+    return {ramEnabled, romBank, ramBank, advancedMode, rtc ? rtc->saveState() : RTCState()};
+}
+
+void MBC::loadState(const MBCState &state) {
+    ramEnabled = state.ramEnabled;
+    romBank = state.romBank;
+    ramBank = state.ramBank;
+    advancedMode = state.advancedMode;
+    if (rtc) {
+        rtc->loadState(state.rtc);
+    }
+    (this->*mapBanks)(true);
+}
+
+int MBC::getROMBankCount() {
+    return romBankCount;
+}
+
+int MBC::getRAMBankCount() {
+    return ramBankCount;
+}
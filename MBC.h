@@ -0,0 +1,154 @@
+/**
+ * @class MBC
+ * @brief Memory Bank Controller for the loaded cartridge
+ * This class decodes writes to the cartridge control registers (0x0000-0x7FFF) and switches
+ * ROM and RAM banks by repointing MMU page-table entries into the cartridge buffers. No bank
+ * data is ever copied. The decoder and mapping are compiled once per mapper type and picked
+ * when the cartridge is loaded, so no write switches on the cartridge type; each control write
+ * is one call through a member function pointer. Only the ROM or RAM window whose bank changed
+ * is repointed.
+ */
+#ifndef MBC_H
+#define MBC_H
+
+#include "global.h"
+#include "Cartridge.h"
+#include "RTC.h"
+#include <memory>
+
+class MMU;
+
+/**
+ * @brief A copy of the bank controller registers.
+ */
+struct MBCState
+{
+    bool ramEnabled;
+    int romBank;
+    int ramBank;
+    bool advancedMode;
+    RTCState rtc; ///< Cartridge clock, unused without one.
+};
+
+class MBC
+{
+private:
+    MMU *mmu;             ///< MMU whose page tables are repointed on bank switches.
+    u8 *rom;              ///< Cartridge ROM buffer.
+    int romBankCount;     ///< Number of 16 KB ROM banks.
+    u8 *ram;              ///< Cartridge RAM buffer, nullptr if the cartridge has none.
+    int ramBankCount;     ///< Number of 8 KB RAM banks.
+    int type;             ///< One of the MBC_* constants.
+
+    bool ramEnabled = false; ///< Whether external RAM is accessible.
+    int romBank = 1;         ///< ROM bank selected for 0x4000-0x7FFF (MBC1: lower 5 bits).
+    int ramBank = 0;         ///< RAM bank selected for 0xA000-0xBFFF (MBC1: upper 2 bits).
+    bool advancedMode = false; ///< MBC1 banking mode select.
+
+    int mappedBanks[3] = {0, 1, -1}; ///< ROM banks at 0x0000 and 0x4000, then the RAM bank at 0xA000 (-1 if unmapped).
+    std::unique_ptr<RTC> rtc;       ///< MBC3 clock, nullptr if the cartridge has none.
+
+    void (MBC::*decodeControl)(u16, u8); ///< writeControl compiled for the cartridge's mapper.
+    void (MBC::*mapBanks)(bool);         ///< updateMapping compiled for the cartridge's mapper.
+
+    /**
+     * @brief Selects the control decoder and bank mapping compiled for a mapper.
+     *
+     * @tparam Type One of the MBC_* constants.
+     */
+    template <int Type>
+    void useMapper();
+
+    /**
+     * @brief Decodes a control register write for one mapper type.
+     *
+     * @tparam Type One of the MBC_* constants.
+     * @param location Address in 0x0000-0x7FFF.
+     * @param data The 8-bit data written.
+     */
+    template <int Type>
+    void writeControl(u16 location, u8 data);
+
+    /**
+     * @brief Repoints the ROM and RAM pages at the currently selected banks.
+     *
+     * @tparam Type One of the MBC_* constants.
+     * @param remapAll true to repoint every window, false to repoint only windows whose bank changed.
+     */
+    template <int Type>
+    void updateMapping(bool remapAll);
+
+public:
+    /**
+     * @brief Construct a new MBC object and map the power-on banks.
+     *
+     * @param mmu MMU whose page tables hold the mapping.
+     * @param cartridge Cartridge providing the ROM and RAM buffers.
+     */
+    MBC(MMU *mmu, Cartridge *cartridge);
+
+    /**
+     * @brief Handles a write to the cartridge control registers.
+     *
+     * @param location Address in 0x0000-0x7FFF.
+     * @param data The 8-bit data written.
+     */
+    void writeControl(u16 location, u8 data);
+
+    /**
+     * @brief Handles a write to external RAM that is not mapped for writing.
+     *
+     * @param location Address in 0xA000-0xBFFF.
+     * @param data The 8-bit data written.
+     * @return long Offset of the RAM byte written, -1 if the write was ignored.
+     */
+    long writeRAM(u16 location, u8 data);
+
+    /**
+     * @brief Handles a read from external RAM that is not mapped for reading.
+     *
+     * @param location Address in 0xA000-0xBFFF.
+     * @return u8 The selected clock register, or 0xFF for disabled or absent RAM.
+     */
+    u8 readRAM(u16 location);
+
+    /**
+     * @brief Sets the emulated cycle count the cartridge clock follows in RTC_EMULATED mode.
+     *
+     * @param cycleCounter Cycles emulated since power on.
+     */
+    void setCycleCounter(const u64 *cycleCounter);
+
+    /**
+     * @brief Stores the cartridge clock in the save file.
+     */
+    void saveClock();
+
+    /**
+     * @brief Get the bank currently mapped behind a page.
+     *
+     * @param page The page (high byte of the address).
+     * @return int The ROM bank for 0x0000-0x7FFF, the RAM bank for 0xA000-0xBFFF (-1 while RAM is
+     * disabled or a clock register is selected), otherwise 0.
+     */
+    int getBank(u8 page);
+
+    /**
+     * @brief Copies the bank controller registers and the cartridge clock.
+     *
+     * @return MBCState The current registers.
+     */
+    MBCState saveState();
+
+    /**
+     * @brief Restores the bank controller registers and maps the banks they select.
+     *
+     * @param state Registers returned by saveState.
+     */
+    void loadState(const MBCState &state);
+
+    int getROMBankCount(); ///< Number of 16 KB ROM banks.
+    int getRAMBankCount(); ///< Number of 8 KB RAM banks.
+};
+
+#endif
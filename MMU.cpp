@@ -1,26 +1,597 @@
 #include "MMU.h"
 #include <cstring>
+#include <cstdio>
+#include <algorithm>
 
-MMU::MMU(Cartridge *cartridge, std::string gameFile) {
-    // Load ROM file into memory
-    std::memcpy(memory, cartridge->getGameData(), cartridge->getFileSize(gameFile));
+// Bits of the sound registers (0xFF10-0xFF3F) that always read back as 1
+static const u8 soundReadMasks[0x30] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF, 0xFF, 0x3F, 0x00, 0xFF, 0xBF, 0x7F, 0xFF, 0x9F, 0xFF, 0xBF, 0xFF,
+    0xFF, 0x00, 0x00, 0xBF, 0x00, 0x00, 0x70, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static u8 readRegister(void *context, u16 location) {
+    return ((MMU *) context)->readIO(location);
+}
+
+static void writeRegister(void *context, u16 location, u8 data) {
+    ((MMU *) context)->writeIO(location, data);
+}
+
+static u8 readUnmapped(void *, u16) {
+    return 0xFF;
+}
+
+static void writeIgnored(void *, u16, u8) {}
+
+/**
+ * @brief Get the WRAM address behind an echo RAM address, so both match the same watchpoint.
+ */
+static u16 getWatchLocation(u16 location) {
+    return (location >= 0xE000 && location < 0xFE00) ? location - 0x2000 : location;
+}
+
+MMU::MMU(Cartridge *cartridge): cartridgeRAM(cartridge->getRAMData()), cartridgeRAMSize(cartridge->getRAMSize()), mbc(this, cartridge) {
+    std::memset(memory, 0, sizeof(memory));
+    mbc.setCycleCounter(&hot.cycles);
+
+    // Guest RAM that snapshots cover: VRAM, WRAM, OAM, I/O and HRAM, then cartridge RAM
+    dirtySlots.resize(PAGE_COUNT + cartridgeRAMSize / PAGE_SIZE, 0);
+    for (int slot = 0x80; slot < 0xA0; slot++) {
+        stateSlots.push_back(slot);
+    }
+    for (int slot = 0xC0; slot < 0xE0; slot++) {
+        stateSlots.push_back(slot);
+    }
+    stateSlots.push_back(0xFE);
+    stateSlots.push_back(0xFF);
+    for (int slot = PAGE_COUNT; slot < (int) dirtySlots.size(); slot++) {
+        stateSlots.push_back(slot);
+    }
+
+    // Nothing has been decoded yet
+    dirtyTiles.set();
+    dirtyMapRows.set();
+
+    // ROM (0x0000-0x7FFF) and external RAM (0xA000-0xBFFF) pages are mapped by the MBC.
+    // VRAM and WRAM are accessed straight from memory; OAM and the I/O page take the slow path.
+    mapReadPages(0x80, 0x20, memory + 0x8000);
+    mapReadPages(0xC0, 0x20, memory + 0xC000);
+    mapWritePages(0x80, 0x20, memory + 0x8000);
+    mapWritePages(0xC0, 0x20, memory + 0xC000);
+
+    // Echo RAM (0xE000-0xFDFF) aliases the same WRAM storage
+    mapReadPages(0xE0, 0x1E, memory + 0xC000);
+    mapWritePages(0xE0, 0x1E, memory + 0xC000);
+
+    // Unused I/O addresses read as 0xFF; HRAM and the remaining registers store their value
+    for (int location = 0xFF00; location <= 0xFFFF; location++) {
+        registerIOHandler(location, nullptr, nullptr, nullptr);
+    }
+    for (u16 location : {0xFF03, 0xFF08, 0xFF09, 0xFF0A, 0xFF0B, 0xFF0C, 0xFF0D, 0xFF0E}) {
+        registerIOHandler(location, readUnmapped, writeIgnored, nullptr);
+    }
+    for (int location = 0xFF4C; location < 0xFF80; location++) {
+        registerIOHandler(location, readUnmapped, writeIgnored, nullptr);
+    }
+
+    // Serial: with no link partner a transfer on the internal clock completes immediately,
+    // shifting in 0xFF
+    registerIOHandler(0xFF02, [](void *context, u16 location) -> u8 {
+        return ((MMU *) context)->readIO(location) | 0x7E;
+    }, [](void *context, u16 location, u8 data) {
+        MMU *mmu = (MMU *) context;
+        if ((data & 0x81) == 0x81) {
+            mmu->writeIO(0xFF01, 0xFF);
+            mmu->writeIO(location, data & 0x7F);
+            mmu->requestInterrupt(0x08);
+        } else {
+            mmu->writeIO(location, data);
+        }
+    }, this);
+
+    // OAM DMA
+    registerIOHandler(DMA_ADDR, nullptr, [](void *context, u16 location, u8 data) {
+        MMU *mmu = (MMU *) context;
+        mmu->writeIO(location, data);
+        mmu->startDMA(data);
+    }, this);
+
+    // Any non-zero write to BOOT unmaps the boot ROM for good
+    registerIOHandler(BOOT_ADDR, readUnmapped, [](void *context, u16, u8 data) {
+        MMU *mmu = (MMU *) context;
+        if (data && mmu->isBootROMMapped()) {
+            mmu->unmapBootROM();
+        }
+    }, this);
+
+    // Interrupt flags: only the lower 5 bits exist
+    registerIOHandler(IF_ADDR, [](void *context, u16 location) -> u8 {
+        return ((MMU *) context)->readIO(location) | 0xE0;
+    }, [](void *context, u16 location, u8 data) {
+        ((MMU *) context)->writeIO(location, data & 0x1F);
+    }, this);
+
+    // Sound: unused bits read as 1, and turning the APU off clears its registers
+    for (int location = 0xFF10; location < 0xFF40; location++) {
+        registerIOHandler(location, [](void *context, u16 location) -> u8 {
+            return ((MMU *) context)->readIO(location) | soundReadMasks[location - 0xFF10];
+        }, nullptr, this);
+    }
+    registerIOHandler(0xFF26, [](void *context, u16 location) -> u8 {
+        return ((MMU *) context)->readIO(location) | 0x70;
+    }, [](void *context, u16 location, u8 data) {
+        MMU *mmu = (MMU *) context;
+        if (!(data & 0x80)) {
+            for (u16 reg = 0xFF10; reg < 0xFF26; reg++) {
+                mmu->writeIO(reg, 0x00);
+            }
+        }
+        mmu->writeIO(location, (data & 0x80) | (mmu->readIO(location) & 0x0F));
+    }, this);
+}
+
+void MMU::registerIOHandler(u16 location, IOReadHandler read, IOWriteHandler write, void *context) {
+    IOHandler &handler = ioHandlers[location & 0xFF];
+    // The default handlers access this MMU's register storage
+    handler.read = read ? read : readRegister;
+    handler.readContext = read ? context : this;
+    handler.write = write ? write : writeRegister;
+    handler.writeContext = write ? context : this;
+}
+
+u8 MMU::readIO(u16 location) {
+    return hot.io[location & 0xFF];
+}
+
+void MMU::writeIO(u16 location, u8 data) {
+    hot.io[location & 0xFF] = data;
+    markSlotDirty(0xFF);
+}
+
+void MMU::requestInterrupt(u8 interrupt) {
+    writeIO(IF_ADDR, readIO(IF_ADDR) | interrupt);
+}
+
+void MMU::mapReadPages(u8 firstPage, int pageCount, u8 *base) {
+    for (int page = 0; page < pageCount; page++) {
+        mappedReadPages[firstPage + page] = base ? base + (page << PAGE_SHIFT) : nullptr;
+        refreshPage(firstPage + page);
+    }
+}
+
+void MMU::mapWritePages(u8 firstPage, int pageCount, u8 *base) {
+    for (int page = 0; page < pageCount; page++) {
+        mappedWritePages[firstPage + page] = base ? base + (page << PAGE_SHIFT) : nullptr;
+        writeSlots[firstPage + page] = base ? getSlot(base + (page << PAGE_SHIFT)) : -1;
+        refreshPage(firstPage + page);
+    }
+}
+
+u8 *MMU::getMappedReadPage(int page) {
+    return (page == 0 && bootROMMapped) ? bootROM : mappedReadPages[page];
+}
+
+void MMU::refreshPage(int page) {
+    // A locked bus, a watchpoint or access counting sends the page to the slow path
+    bool locked = dmaActive || heatmap;
+    bool readWatched = watchedPages[page] & (WATCH_READ | WATCH_EXECUTE);
+    bool writeWatched = watchedPages[page] & WATCH_WRITE;
+    // VRAM writes are tracked for the renderer
+    bool writeTracked = (page >= 0x80) && (page < 0xA0);
+    // Clean pages are write-protected until their first write after a snapshot
+    bool writeClean = trackingWrites && mappedWritePages[page] && writeSlots[page] >= 0 && !dirtySlots[writeSlots[page]];
+    readPages[page] = (locked || readWatched) ? nullptr : getMappedReadPage(page);
+    writePages[page] = (locked || writeWatched || writeTracked || writeClean) ? nullptr : mappedWritePages[page];
+}
+
+void MMU::startDMA(u8 sourcePage) {
+    // Sources above WRAM read the WRAM underneath
+    if (sourcePage >= 0xE0) {
+        sourcePage -= 0x20;
+    }
+
+    u8 *source = getMappedReadPage(sourcePage);
+    if (source) {
+        std::memcpy(memory + 0xFE00, source, OAM_SIZE);
+    } else {
+        std::memset(memory + 0xFE00, 0xFF, OAM_SIZE);
+    }
+    markSlotDirty(0xFE);
+
+    // The main loop stops between instructions when the window closes
+    dmaActive = true;
+    dmaEnd = hot.cycles + DMA_CYCLES;
+    hot.nextEvent = std::min(hot.nextEvent, dmaEnd);
+    for (int page = 0; page < PAGE_COUNT; page++) {
+        refreshPage(page);
+    }
+}
+
+bool MMU::isDMAActive() {
+    return dmaActive;
+}
+
+u64 MMU::getDMAEnd() {
+    return dmaEnd;
+}
+
+void MMU::updateDMA() {
+    if (dmaActive && hot.cycles >= dmaEnd) {
+        dmaActive = false;
+        oamDirty = true;
+        for (int page = 0; page < PAGE_COUNT; page++) {
+            refreshPage(page);
+        }
+    }
 }
 
 u8 MMU::readByte(u16 location) {
-    return memory[location];
+    u8 *page = readPages[location >> PAGE_SHIFT];
+    if (page) {
+        return page[location & 0xFF];
+    }
+    return readSlow(location, WATCH_READ);
+}
+
+u8 MMU::fetchByte(u16 location) {
+    u8 *page = readPages[location >> PAGE_SHIFT];
+    if (page) {
+        return page[location & 0xFF];
+    }
+    return readSlow(location, WATCH_EXECUTE);
 }
 
 void MMU::writeByte(u16 location, u8 byte) {
-    // if (location == 0xFF04) {
-    //     memory[location] = 0x00;
-    // }
-    if ((location >= 0xE000) && (location < 0xFE00)) {
-        writeByte(location - 0x2000, byte);
-        memory[location] = byte;
+    u8 *page = writePages[location >> PAGE_SHIFT];
+    if (page) {
+        page[location & 0xFF] = byte;
+        return;
+    }
+    writeSlow(location, byte);
+}
+
+u8 MMU::readSlow(u16 location, u8 access) {
+    int page = location >> PAGE_SHIFT;
+    u8 *mapped = getMappedReadPage(page);
+    u8 value = (mapped && !dmaActive) ? mapped[location & 0xFF] : readDevice(location);
+    if (heatmap) {
+        heatmap->recordRead(location, mbc.getBank(page));
+    }
+    if (watchedPages[page] & access) {
+        checkWatchpoints(location, access, value, value);
+    }
+    return value;
+}
+
+void MMU::writeSlow(u16 location, u8 byte) {
+    int page = location >> PAGE_SHIFT;
+    u8 *mapped = mappedWritePages[page];
+    if (heatmap) {
+        heatmap->recordWrite(location, mbc.getBank(page));
+    }
+    if (watchedPages[page] & WATCH_WRITE) {
+        u8 *readable = getMappedReadPage(page);
+        u8 previous = readable ? readable[location & 0xFF] : (location >= 0xFF00) ? readIO(location) : memory[location];
+        checkWatchpoints(location, WATCH_WRITE, previous, byte);
+    }
+    if (mapped && !dmaActive) {
+        if (page >= 0x80 && page < 0xA0 && mapped[location & 0xFF] != byte) {
+            markVRAMDirty(location);
+        }
+        mapped[location & 0xFF] = byte;
+        markSlotDirty(writeSlots[page]);
+    } else {
+        writeDevice(location, byte);
+    }
+}
+
+u8 MMU::readDevice(u16 location) {
+    if (location >= 0xFF00) {
+        IOHandler &handler = ioHandlers[location & 0xFF];
+        return handler.read(handler.readContext, location);
+    }
+    // Only HRAM and I/O respond while DMA holds the bus
+    if (dmaActive) {
+        return 0xFF;
+    }
+    // External RAM that is disabled or absent, or MBC3 clock registers
+    if ((location >= 0xA000) && (location < 0xC000)) {
+        return mbc.readRAM(location);
+    }
+    // Unusable region after OAM
+    if (location >= 0xFEA0) {
+        return 0x00;
+    }
+    return memory[location];
+}
+
+void MMU::writeDevice(u16 location, u8 byte) {
+    if (location >= 0xFF00) {
+        IOHandler &handler = ioHandlers[location & 0xFF];
+        handler.write(handler.writeContext, location, byte);
+        return;
+    }
+    if (dmaActive) {
+        return;
+    }
+    if (location < 0x8000) {
+        mbc.writeControl(location, byte);
+        return;
     }
-    else if ((location >= 0xFEA0) && (location < 0xFEFF)) {}
-    else {
+    // External RAM the bank controller keeps off the page tables
+    if ((location >= 0xA000) && (location < 0xC000)) {
+        long offset = mbc.writeRAM(location, byte);
+        if (offset >= 0) {
+            markSlotDirty(PAGE_COUNT + (offset >> PAGE_SHIFT));
+        }
+        return;
+    }
+    // OAM; the unusable region after it ignores writes
+    if (location < 0xFEA0) {
         memory[location] = byte;
+        markSlotDirty(0xFE);
+        oamDirty = true;
+    }
+}
+
+void MMU::markVRAMDirty(u16 location) {
+    u16 offset = location - 0x8000;
+    if (offset < 0x1800) {
+        dirtyTiles.set(offset >> 4);
+    } else {
+        dirtyMapRows.set((offset - 0x1800) >> 5);
+    }
+}
+
+std::bitset<TILE_COUNT> MMU::takeDirtyTiles() {
+    std::bitset<TILE_COUNT> tiles = dirtyTiles;
+    dirtyTiles.reset();
+    return tiles;
+}
+
+std::bitset<MAP_ROW_COUNT> MMU::takeDirtyMapRows() {
+    std::bitset<MAP_ROW_COUNT> rows = dirtyMapRows;
+    dirtyMapRows.reset();
+    return rows;
+}
+
+bool MMU::takeOAMDirty() {
+    bool dirty = oamDirty;
+    oamDirty = false;
+    return dirty;
+}
+
+const u8 *MMU::getOAM() {
+    return memory + 0xFE00;
+}
+
+const u8 *MMU::getVRAM() {
+    return memory + 0x8000;
+}
+
+bool MMU::loadBootROM(std::string bootFile) {
+    FILE *fp = fopen(bootFile.c_str(), "rb");
+    if (!fp) {
+        printf("Cannot open boot ROM %s.\n", bootFile.c_str());
+        return false;
+    }
+    size_t size = fread(bootROM, 1, BOOT_ROM_SIZE, fp);
+    fclose(fp);
+    if (size != BOOT_ROM_SIZE) {
+        printf("Boot ROM %s is not %d bytes.\n", bootFile.c_str(), BOOT_ROM_SIZE);
+        return false;
+    }
+
+    // The boot ROM initialises the registers itself
+    std::memset(hot.io, 0x00, 0x80);
+    markSlotDirty(0xFF);
+    bootROMMapped = true;
+    refreshPage(0);
+    return true;
+}
+
+bool MMU::isBootROMMapped() {
+    return bootROMMapped;
+}
+
+void MMU::unmapBootROM() {
+    bootROMMapped = false;
+    refreshPage(0);
+}
+
+const u8 *MMU::getBootROM() {
+    return bootROM;
+}
+
+std::vector<u8> MMU::saveRAM() {
+    std::vector<u8> state(memory + 0x8000, memory + 0x10000);
+    std::memcpy(state.data() + 0x7F00, hot.io, PAGE_SIZE);
+    return state;
+}
+
+void MMU::loadRAM(const std::vector<u8> &state) {
+    std::memcpy(memory + 0x8000, state.data(), 0x7F00);
+    std::memcpy(hot.io, state.data() + 0x7F00, PAGE_SIZE);
+    dirtyTiles.set();
+    dirtyMapRows.set();
+    oamDirty = true;
+    for (int slot : stateSlots) {
+        if (slot < PAGE_COUNT) {
+            markSlotDirty(slot);
+        }
+    }
+}
+
+int MMU::getSlot(u8 *host) {
+    if (host >= memory && host < memory + sizeof(memory)) {
+        return (host - memory) >> PAGE_SHIFT;
+    }
+    if (cartridgeRAM && host >= cartridgeRAM && host < cartridgeRAM + cartridgeRAMSize) {
+        return PAGE_COUNT + ((host - cartridgeRAM) >> PAGE_SHIFT);
+    }
+    return -1;
+}
+
+u8 *MMU::getSlotData(int slot) {
+    if (slot == 0xFF) {
+        return hot.io;
+    }
+    if (slot < PAGE_COUNT) {
+        return memory + (slot << PAGE_SHIFT);
+    }
+    return cartridgeRAM + ((slot - PAGE_COUNT) << PAGE_SHIFT);
+}
+
+void MMU::markSlotDirty(int slot) {
+    if (dirtySlots[slot]) {
+        return;
+    }
+    dirtySlots[slot] = 1;
+    dirtyList.push_back(slot);
+    if (!trackingWrites) {
+        return;
+    }
+
+    // Let the pages writing this slot back on the fast path; WRAM is also written through echo RAM
+    int page = (slot < PAGE_COUNT) ? slot : 0xA0 + ((slot - PAGE_COUNT) & 0x1F);
+    for (int alias : {page, page + 0x20}) {
+        if (alias < PAGE_COUNT && mappedWritePages[alias] && writeSlots[alias] == slot) {
+            refreshPage(alias);
+        }
+    }
+}
+
+void MMU::startWriteTracking() {
+    for (int slot : dirtyList) {
+        dirtySlots[slot] = 0;
+    }
+    dirtyList.clear();
+    trackingWrites = true;
+    for (int page = 0; page < PAGE_COUNT; page++) {
+        refreshPage(page);
+    }
+}
+
+void MMU::takeSnapshot(MemorySnapshot &snapshot) {
+    // The first snapshot copies everything, later ones only what was written since
+    bool full = syncedPages.empty();
+    if (full) {
+        syncedPages.resize(dirtySlots.size());
+    }
+    snapshot.pages = syncedPages;
+    for (int slot : full ? stateSlots : dirtyList) {
+        std::shared_ptr<PageData> page = std::allocate_shared<PageData>(ArenaAllocator<PageData>());
+        std::memcpy(page->data(), getSlotData(slot), PAGE_SIZE);
+        snapshot.pages[slot] = page;
+    }
+    snapshot.mbc = mbc.saveState();
+    snapshot.bootROMMapped = bootROMMapped;
+    snapshot.dmaActive = dmaActive;
+    snapshot.dmaEnd = dmaEnd;
+
+    syncedPages = snapshot.pages;
+    startWriteTracking();
+}
+
+void MMU::restoreSnapshot(const MemorySnapshot &snapshot) {
+    // Pages shared between the snapshot and memory's last synced state only need copying if written since
+    bool full = syncedPages.size() != snapshot.pages.size();
+    for (int slot : stateSlots) {
+        if (full || dirtySlots[slot] || syncedPages[slot] != snapshot.pages[slot]) {
+            std::memcpy(getSlotData(slot), snapshot.pages[slot]->data(), PAGE_SIZE);
+            if (slot >= 0x80 && slot < 0xA0) {
+                for (u16 location = slot << PAGE_SHIFT; location < ((slot + 1) << PAGE_SHIFT); location += 0x10) {
+                    markVRAMDirty(location);
+                }
+            }
+            if (slot == 0xFE) {
+                oamDirty = true;
+            }
+        }
+    }
+    bootROMMapped = snapshot.bootROMMapped;
+    dmaActive = snapshot.dmaActive;
+    dmaEnd = snapshot.dmaEnd;
+    mbc.loadState(snapshot.mbc);
+
+    syncedPages = snapshot.pages;
+    startWriteTracking();
+}
+
+int MMU::getDirtyPageCount() {
+    return dirtyList.size();
+}
+
+void MMU::enableHeatmap(bool enabled) {
+    if (enabled && !heatmap) {
+        heatmap.reset(new Heatmap(mbc.getROMBankCount(), mbc.getRAMBankCount()));
+    } else if (!enabled) {
+        heatmap.reset();
+    }
+    for (int page = 0; page < PAGE_COUNT; page++) {
+        refreshPage(page);
+    }
+}
+
+Heatmap *MMU::getHeatmap() {
+    return heatmap.get();
+}
+
+HotState *MMU::getHotState() {
+    return &hot;
+}
+
+void MMU::saveClock() {
+    mbc.saveClock();
+}
+
+void MMU::addWatchpoint(u16 location, u8 type, WatchHandler handler, void *context) {
+    location = getWatchLocation(location);
+    watchpoints.push_back({location, type, handler, context});
+    watchedPages[location >> PAGE_SHIFT] |= type;
+    refreshPage(location >> PAGE_SHIFT);
+    refreshEchoPage(location >> PAGE_SHIFT);
+}
+
+void MMU::refreshEchoPage(int page) {
+    // WRAM at 0xC000-0xDDFF is also reachable through echo RAM
+    if (page >= 0xC0 && page < 0xDE) {
+        watchedPages[page + 0x20] = watchedPages[page];
+        refreshPage(page + 0x20);
+    }
+}
+
+void MMU::removeWatchpoint(u16 location, u8 type) {
+    location = getWatchLocation(location);
+    int page = location >> PAGE_SHIFT;
+    watchedPages[page] = 0;
+    for (size_t i = 0; i < watchpoints.size();) {
+        Watchpoint &watchpoint = watchpoints[i];
+        if (watchpoint.location == location) {
+            watchpoint.type &= ~type;
+        }
+        if (watchpoint.type == 0) {
+            watchpoints.erase(watchpoints.begin() + i);
+            continue;
+        }
+        if ((watchpoint.location >> PAGE_SHIFT) == page) {
+            watchedPages[page] |= watchpoint.type;
+        }
+        i++;
+    }
+    refreshPage(page);
+    refreshEchoPage(page);
+}
+
+void MMU::checkWatchpoints(u16 location, u8 access, u8 previous, u8 value) {
+    // Handlers may add or remove watchpoints, so index rather than iterate
+    for (size_t i = 0; i < watchpoints.size(); i++) {
+        Watchpoint watchpoint = watchpoints[i];
+        if (watchpoint.location == getWatchLocation(location) && (watchpoint.type & access)) {
+            WatchHit hit = {location, access, previous, value};
+            watchpoint.handler(watchpoint.context, hit);
+        }
     }
 }
 
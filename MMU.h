@@ -4,6 +4,10 @@
  * @author Lesley Hou
  * This class represents the Memory Management Unit (MMU) for an emulator object.
  * It is responsible for handling memory-related operations, such as reading and writing bytes and words.
+ *
+ * The 64 KB address space is split into 256 pages of 256 bytes. Each page has a host pointer in a
+ * read table and in a write table; plain RAM and ROM accesses index straight through those pointers.
+ * A null entry sends the access to a slow-path handler (I/O registers, MBC control, OAM).
  */
 
 #ifndef MMU_H
@@ -11,21 +15,269 @@
 
 #include "global.h"
 #include "Cartridge.h"
+#include "MBC.h"
+#include "Heatmap.h"
+#include "PageArena.h"
+#include "HotState.h"
+#include <vector>
+#include <bitset>
+#include <memory>
+#include <array>
+
+#define PAGE_SHIFT 8
+#define PAGE_SIZE 0x100
+#define PAGE_COUNT 0x100
+
+#define IF_ADDR 0xFF0F
+#define IE_ADDR 0xFFFF
+#define DMA_ADDR 0xFF46
+#define BOOT_ADDR 0xFF50
+#define BOOT_ROM_SIZE 0x100
+#define OAM_SIZE 0xA0
+#define DMA_CYCLES 160
+#define TILE_COUNT 384
+#define MAP_ROW_COUNT 64
+
+/**
+ * @brief Handler for reads from an I/O register.
+ *
+ * @param context The object the handler was registered with
+ * @param location The register address in 0xFF00-0xFFFF
+ * @return u8 The value seen by the CPU
+ */
+typedef u8 (*IOReadHandler)(void *context, u16 location);
+
+/**
+ * @brief Handler for writes to an I/O register.
+ *
+ * @param context The object the handler was registered with
+ * @param location The register address in 0xFF00-0xFFFF
+ * @param data The value written by the CPU
+ */
+typedef void (*IOWriteHandler)(void *context, u16 location, u8 data);
+
+#define WATCH_READ 0x1
+#define WATCH_WRITE 0x2
+#define WATCH_EXECUTE 0x4
+
+/**
+ * @brief Details of an access that hit a watchpoint.
+ */
+struct WatchHit
+{
+    u16 location; ///< Address that was accessed.
+    u8 type;      ///< WATCH_READ, WATCH_WRITE or WATCH_EXECUTE.
+    u8 previous;  ///< Value before the access.
+    u8 value;     ///< Value read, fetched or written.
+};
+
+/**
+ * @brief Handler called when an access hits a watchpoint.
+ *
+ * @param context The object the watchpoint was registered with
+ * @param hit The access that hit the watchpoint
+ */
+typedef void (*WatchHandler)(void *context, const WatchHit &hit);
+
+/**
+ * @brief A watched guest address.
+ */
+struct Watchpoint
+{
+    u16 location;
+    u8 type; ///< Combination of WATCH_READ, WATCH_WRITE and WATCH_EXECUTE.
+    WatchHandler handler;
+    void *context;
+};
+
+/**
+ * @brief Read and write handlers for one address of the 0xFF00-0xFFFF page.
+ */
+struct IOHandler
+{
+    IOReadHandler read;
+    void *readContext;
+    IOWriteHandler write;
+    void *writeContext;
+};
+
+typedef std::array<u8, PAGE_SIZE> PageData;
+
+/**
+ * @brief A copy of guest RAM and the memory-side machine state. Pages that did not change between
+ * two snapshots share the same PageData, so taking a snapshot only copies the dirty pages.
+ */
+struct MemorySnapshot
+{
+    std::vector<std::shared_ptr<const PageData>> pages; ///< Indexed by storage slot, see MMU::getSlotData
+    MBCState mbc;
+    bool bootROMMapped;
+    bool dmaActive;
+    u64 dmaEnd;
+};
 
 class MMU
 {
 private:
+    HotState hot = {};  ///< CPU registers, cycle count and the I/O page, shared with the CPU
+
+    /**
+     * @brief Memory array to store bytes for the emulator. The I/O page (0xFF00-0xFFFF) lives in hot instead.
+     *
+     */
+    u8 memory[0x10000]; ///< Gameboy Memory
+
+    u8 *readPages[PAGE_COUNT] = {};  ///< Host pointer for each page on read, nullptr to take the slow path
+    u8 *writePages[PAGE_COUNT] = {}; ///< Host pointer for each page on write, nullptr to take the slow path
+    u8 *mappedReadPages[PAGE_COUNT] = {};  ///< Memory mapped to each page on read, before bus locking
+    u8 *mappedWritePages[PAGE_COUNT] = {}; ///< Memory mapped to each page on write, before bus locking
+
+    std::vector<Watchpoint> watchpoints; ///< All active watchpoints
+    u8 watchedPages[PAGE_COUNT] = {};    ///< Watch types present on each page, which keep it off the fast path
+
+    std::bitset<TILE_COUNT> dirtyTiles;      ///< Tiles in 0x8000-0x97FF written since the renderer last took them
+    std::bitset<MAP_ROW_COUNT> dirtyMapRows; ///< Rows of the two background maps written since the renderer last took them
+    bool oamDirty = true;                    ///< OAM written or filled by DMA since the renderer last took it
+
+    u8 bootROM[BOOT_ROM_SIZE];   ///< DMG boot ROM image
+    bool bootROMMapped = false;  ///< Whether the boot ROM overlays 0x0000-0x00FF
+
+    std::unique_ptr<Heatmap> heatmap; ///< Access counters, nullptr unless enabled
+
+    bool dmaActive = false; ///< Whether an OAM DMA holds the bus, so that only HRAM and I/O respond
+    u64 dmaEnd = 0;         ///< Cycle count at which the current OAM DMA releases the bus
+
+    u8 *cartridgeRAM;      ///< External RAM buffer, nullptr if the cartridge has none
+    long cartridgeRAMSize; ///< Size of cartridgeRAM in bytes
+
+    /** @brief Storage slot written through each page, -1 for none. Initialized before the MBC maps its pages. */
+    std::array<int, PAGE_COUNT> writeSlots = [] { std::array<int, PAGE_COUNT> slots; slots.fill(-1); return slots; }();
+    std::vector<u8> dirtySlots;  ///< Slots written since the last snapshot was taken or restored
+    std::vector<int> dirtyList;  ///< The slots set in dirtySlots, for clearing them
+    std::vector<int> stateSlots; ///< Every slot holding guest RAM
+    std::vector<std::shared_ptr<const PageData>> syncedPages; ///< Snapshot pages matching memory apart from dirty slots
+    bool trackingWrites = false; ///< Whether clean pages are kept off the write fast path to catch their first write
+
+    MBC mbc; ///< Memory bank controller, owns the ROM and external RAM pages
+
+    IOHandler ioHandlers[PAGE_SIZE]; ///< Handlers for I/O registers, HRAM and IE, indexed by the low address byte
+
+    /**
+     * @brief Handles reads from pages without a fast-path pointer.
+     *
+     * @param location The memory location from which to read the byte
+     * @param access WATCH_READ for data reads, WATCH_EXECUTE for opcode fetches
+     * @return u8 The 8-bit byte read from the specified location
+     */
+    u8 readSlow(u16 location, u8 access);
+
     /**
-     * @brief Memory array to store bytes for the emulator.
+     * @brief Handles writes to pages without a fast-path pointer.
      *
+     * @param location The memory location to which the byte will be written
+     * @param data The 8-bit data to be written to the specified location
      */
-    u8 memory[0xFFFF]; ///< Gameboy Memory
+    void writeSlow(u16 location, u8 data);
+
+    /**
+     * @brief Reads from unmapped memory: I/O registers, OAM, disabled RAM and the locked bus.
+     *
+     * @param location The memory location from which to read the byte
+     * @return u8 The 8-bit byte read from the specified location
+     */
+    u8 readDevice(u16 location);
+
+    /**
+     * @brief Writes to unmapped memory: I/O registers, MBC control, OAM and the locked bus.
+     *
+     * @param location The memory location to which the byte will be written
+     * @param data The 8-bit data to be written to the specified location
+     */
+    void writeDevice(u16 location, u8 data);
+
+    /**
+     * @brief Records which tile or background map row a VRAM write touched.
+     *
+     * @param location The VRAM address written
+     */
+    void markVRAMDirty(u16 location);
+
+    /**
+     * @brief Calls the handlers of every watchpoint matching an access.
+     *
+     * @param location The memory location accessed
+     * @param access The kind of access
+     * @param previous The value before the access
+     * @param value The value read or written
+     */
+    void checkWatchpoints(u16 location, u8 access, u8 previous, u8 value);
+
+    /**
+     * @brief Copies the watch types of a WRAM page to its echo RAM alias.
+     *
+     * @param page The watched page
+     */
+    void refreshEchoPage(int page);
+
+    /**
+     * @brief Get the memory mapped to a page on read, with the boot ROM overlay applied.
+     *
+     * @param page The page (high byte of the address)
+     * @return u8* Host memory backing the page, or nullptr if it is handled by readDevice
+     */
+    u8 *getMappedReadPage(int page);
+
+    /**
+     * @brief Recomputes the fast-path entries of a page from its mapping and the bus state.
+     *
+     * @param page The page (high byte of the address) to refresh
+     */
+    void refreshPage(int page);
+
+    /**
+     * @brief Get the storage slot behind a host pointer. Slots 0x00-0xFF are the 256-byte pages
+     * of the internal memory array and slots from 0x100 up are pages of the cartridge RAM.
+     *
+     * @param host Host memory mapped to a page
+     * @return int The slot, or -1 for memory that is not guest RAM
+     */
+    int getSlot(u8 *host);
+
+    /**
+     * @brief Get the host memory of a storage slot.
+     *
+     * @param slot A storage slot from getSlot
+     * @return u8* The 256 bytes held by the slot
+     */
+    u8 *getSlotData(int slot);
+
+    /**
+     * @brief Records the first write to a slot since the last snapshot and puts the pages
+     * mapping it back on the write fast path.
+     *
+     * @param slot The storage slot written
+     */
+    void markSlotDirty(int slot);
+
+    /**
+     * @brief Clears the dirty slots and write-protects every page of guest RAM again.
+     */
+    void startWriteTracking();
+
+    /**
+     * @brief Starts an OAM DMA transfer. The 160 bytes are copied at once, and the bus stays
+     * locked for 160 M-cycles. The end of the transfer is scheduled as the main loop's next event.
+     *
+     * @param sourcePage The high byte of the source address
+     */
+    void startDMA(u8 sourcePage);
+
 public:
     /**
      * @brief Constructor for MMU object
-     * @param void
+     * @param cartridge The cartridge whose ROM and RAM are mapped into the address space
      */
-    MMU(Cartridge *cartridge, std::string gameFile);
+    MMU(Cartridge *cartridge);
     /**
      * @brief Destroyer for MMU object
      * @param void
@@ -38,6 +290,14 @@ public:
      * @return u8 The 8-bit byte read from the specified location
      */
     u8 readByte(u16 location);
+    /**
+     * @brief Fetches an opcode byte from the specified memory location. Identical to readByte
+     * except that it triggers execute watchpoints instead of read watchpoints.
+     *
+     * @param location The memory location from which to fetch the byte
+     * @return u8 The 8-bit byte at the specified location
+     */
+    u8 fetchByte(u16 location);
     /**
      * @brief Writes an 8-bit byte to the specified memory location
      *
@@ -59,6 +319,223 @@ public:
      * @param data The 16-bit data to be written to the specified location
      */
     void writeWord(u16 location, u16 data);
+
+    /**
+     * @brief Points a run of pages in the read table at host memory.
+     *
+     * @param firstPage The first page (high byte of the address) to map
+     * @param pageCount The number of consecutive pages to map
+     * @param base Host memory backing the first page, or nullptr to route the pages to the slow path
+     */
+    void mapReadPages(u8 firstPage, int pageCount, u8 *base);
+
+    /**
+     * @brief Points a run of pages in the write table at host memory.
+     *
+     * @param firstPage The first page (high byte of the address) to map
+     * @param pageCount The number of consecutive pages to map
+     * @param base Host memory backing the first page, or nullptr to route the pages to the slow path
+     */
+    void mapWritePages(u8 firstPage, int pageCount, u8 *base);
+
+    /**
+     * @brief Installs the handlers called when the CPU accesses an I/O register.
+     *
+     * @param location The register address in 0xFF00-0xFFFF
+     * @param read Handler for reads, or nullptr to read the stored register value
+     * @param write Handler for writes, or nullptr to store the value as written
+     * @param context Object passed back to the handlers
+     */
+    void registerIOHandler(u16 location, IOReadHandler read, IOWriteHandler write, void *context);
+
+    /**
+     * @brief Reads the stored value of an I/O register without calling its handler.
+     *
+     * @param location The register address in 0xFF00-0xFFFF
+     * @return u8 The stored register value
+     */
+    u8 readIO(u16 location);
+
+    /**
+     * @brief Stores the value of an I/O register without calling its handler.
+     * Used by the hardware itself, e.g. the timer incrementing DIV.
+     *
+     * @param location The register address in 0xFF00-0xFFFF
+     * @param data The value to store
+     */
+    void writeIO(u16 location, u8 data);
+
+    /**
+     * @brief Whether an OAM DMA transfer is holding the bus.
+     *
+     * @return true while the DMA window is open
+     */
+    bool isDMAActive();
+
+    /**
+     * @brief Get the cycle count at which the current OAM DMA releases the bus.
+     *
+     * @return u64 The end of the DMA window, meaningful only while isDMAActive
+     */
+    u64 getDMAEnd();
+
+    /**
+     * @brief Releases the bus if the OAM DMA window has elapsed. Called when the main loop reaches its next event.
+     */
+    void updateDMA();
+
+    /**
+     * @brief Watches a guest address. Only the page containing it leaves the fast path,
+     * so accesses everywhere else cost nothing. WRAM and its echo RAM alias are watched together.
+     *
+     * @param location The address to watch
+     * @param type Combination of WATCH_READ, WATCH_WRITE and WATCH_EXECUTE
+     * @param handler Called for every matching access
+     * @param context Object passed back to the handler
+     */
+    void addWatchpoint(u16 location, u8 type, WatchHandler handler, void *context);
+
+    /**
+     * @brief Stops watching a guest address for the given kinds of access.
+     *
+     * @param location The watched address
+     * @param type Combination of WATCH_READ, WATCH_WRITE and WATCH_EXECUTE to remove
+     */
+    void removeWatchpoint(u16 location, u8 type);
+
+    /**
+     * @brief Returns the tiles changed since the last call and clears them.
+     *
+     * @return std::bitset<TILE_COUNT> One bit per 16-byte tile in 0x8000-0x97FF
+     */
+    std::bitset<TILE_COUNT> takeDirtyTiles();
+
+    /**
+     * @brief Returns the background map rows changed since the last call and clears them.
+     *
+     * @return std::bitset<MAP_ROW_COUNT> Rows 0-31 of the map at 0x9800, then rows 0-31 of the map at 0x9C00
+     */
+    std::bitset<MAP_ROW_COUNT> takeDirtyMapRows();
+
+    /**
+     * @brief Returns whether OAM was written, or a DMA transfer into it completed, since the last call, and clears it.
+     *
+     * @return true if the sprite attributes may have changed
+     */
+    bool takeOAMDirty();
+
+    /**
+     * @brief Getter method for OAM, for the renderer to read without going through the bus.
+     *
+     * @return const u8* The OAM_SIZE bytes at 0xFE00
+     */
+    const u8 *getOAM();
+
+    /**
+     * @brief Getter method for VRAM, for the renderer to read without going through the bus.
+     *
+     * @return const u8* The 0x2000 bytes at 0x8000-0x9FFF
+     */
+    const u8 *getVRAM();
+
+    /**
+     * @brief Overlays a DMG boot ROM image on 0x0000-0x00FF and resets the I/O registers to their
+     * power-on state. The overlay is removed when the boot ROM writes to 0xFF50.
+     *
+     * @param bootFile Name of the 256-byte boot ROM file
+     * @return true if the boot ROM was loaded and mapped
+     */
+    bool loadBootROM(std::string bootFile);
+
+    /**
+     * @brief Whether the boot ROM still overlays the start of the cartridge ROM.
+     *
+     * @return true until the boot ROM is unmapped
+     */
+    bool isBootROMMapped();
+
+    /**
+     * @brief Removes the boot ROM overlay, exposing the cartridge ROM at 0x0000-0x00FF.
+     */
+    void unmapBootROM();
+
+    /**
+     * @brief Getter method for the boot ROM image.
+     *
+     * @return const u8* The 256-byte boot ROM image
+     */
+    const u8 *getBootROM();
+
+    /**
+     * @brief Copies the internal memory (0x8000-0xFFFF) into a buffer. External RAM is not included.
+     *
+     * @return std::vector<u8> VRAM, WRAM, OAM, I/O registers and HRAM
+     */
+    std::vector<u8> saveRAM();
+
+    /**
+     * @brief Restores the writable address space from a buffer made by saveRAM.
+     *
+     * @param state The buffer to restore
+     */
+    void loadRAM(const std::vector<u8> &state);
+
+    /**
+     * @brief Saves guest RAM and the memory-side state. Only pages written since the previous
+     * snapshot was taken or restored are copied; the rest are shared with that snapshot.
+     *
+     * @param snapshot The snapshot to fill
+     */
+    void takeSnapshot(MemorySnapshot &snapshot);
+
+    /**
+     * @brief Restores guest RAM and the memory-side state. Only pages that differ from the snapshot,
+     * because they were written or because they differ from the last synced snapshot, are copied.
+     *
+     * @param snapshot A snapshot filled by takeSnapshot
+     */
+    void restoreSnapshot(const MemorySnapshot &snapshot);
+
+    /**
+     * @brief Get the number of pages written since the last snapshot was taken or restored.
+     *
+     * @return int The number of dirty 256-byte pages
+     */
+    int getDirtyPageCount();
+
+    /**
+     * @brief Starts or stops counting accesses per page and register. While enabled every
+     * access takes the slow path so it can be counted.
+     *
+     * @param enabled true to count accesses, false to discard the counters
+     */
+    void enableHeatmap(bool enabled);
+
+    /**
+     * @brief Get the access counters.
+     *
+     * @return Heatmap* The counters, or nullptr if counting is disabled
+     */
+    Heatmap *getHeatmap();
+
+    /**
+     * @brief Get the per-instruction state block holding the CPU registers and the I/O page.
+     *
+     * @return HotState* The block, valid for the life of this MMU
+     */
+    HotState *getHotState();
+
+    /**
+     * @brief Stores the cartridge clock, if any, in the save file.
+     */
+    void saveClock();
+
+    /**
+     * @brief Sets a bit in the interrupt flag register (IF).
+     *
+     * @param interrupt The interrupt bit to request
+     */
+    void requestInterrupt(u8 interrupt);
 };
 
 #endif
@@ -0,0 +1,57 @@
+#include "PageArena.h"
+#include "HugePages.h"
+#include <cstdio>
+
+PageArena &PageArena::getInstance() {
+    static PageArena arena;
+    return arena;
+}
+
+void *PageArena::allocate(size_t size) {
+    if (size > ARENA_BLOCK_SIZE) {
+        return ::operator new(size);
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    if (freeList) {
+        void *block = freeList;
+        freeList = *(void **) block;
+        return block;
+    }
+    if (next == end) {
+        // Out of blocks: fall back to the heap if no more memory can be mapped
+        u8 *chunk = HugePages::allocate(HUGE_PAGE_SIZE);
+        if (!chunk) {
+            return ::operator new(ARENA_BLOCK_SIZE);
+        }
+        chunks.push_back(chunk);
+        next = chunk;
+        end = chunk + HUGE_PAGE_SIZE / ARENA_BLOCK_SIZE * ARENA_BLOCK_SIZE;
+    }
+    void *block = next;
+    next += ARENA_BLOCK_SIZE;
+    return block;
+}
+
+void PageArena::deallocate(void *block, size_t size) {
+    if (size > ARENA_BLOCK_SIZE) {
+        ::operator delete(block);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(lock);
+    *(void **) block = freeList;
+    freeList = block;
+}
+
+void PageArena::report(const char *name) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (chunks.empty()) {
+        return;
+    }
+    size_t granted = 0;
+    for (u8 *chunk : chunks) {
+        granted += HugePages::getGrantedBytes(chunk, HUGE_PAGE_SIZE);
+    }
+    printf("%s: %zu of %zu KB backed by huge pages.\n", name, granted / 1024, chunks.size() * HUGE_PAGE_SIZE / 1024);
+}
@@ -0,0 +1,89 @@
+/**
+ * @class PageArena
+ * @brief Snapshot page pool on huge pages
+ * Snapshot pages are carved out of 2 MB huge-page chunks instead of the general heap, so thousands
+ * of saved states share a handful of TLB entries. Freed blocks are reused, and chunks stay mapped
+ * for the life of the process.
+ */
+#ifndef PAGEARENA_H
+#define PAGEARENA_H
+
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+#include "global.h"
+
+#define ARENA_BLOCK_SIZE 320 ///< Fits a 256-byte page and its shared_ptr control block.
+
+class PageArena
+{
+private:
+    std::vector<u8 *> chunks;  ///< Huge-page chunks blocks are carved from.
+    void *freeList = nullptr;  ///< Freed blocks, each holding a pointer to the next.
+    u8 *next = nullptr;        ///< Next never-used block in the newest chunk.
+    u8 *end = nullptr;         ///< End of the newest chunk.
+    std::mutex lock;           ///< Guards the pool for emulators on other threads.
+
+public:
+    /**
+     * @brief Get the pool shared by every MMU.
+     */
+    static PageArena &getInstance();
+
+    /**
+     * @brief Allocates a block, or falls back to the heap for requests larger than a block.
+     *
+     * @param size Number of bytes.
+     * @return void* The memory.
+     */
+    void *allocate(size_t size);
+
+    /**
+     * @brief Frees memory returned by allocate.
+     *
+     * @param block The memory.
+     * @param size The size passed to allocate.
+     */
+    void deallocate(void *block, size_t size);
+
+    /**
+     * @brief Prints how much of the pool is backed by huge pages.
+     *
+     * @param name Name of the pool.
+     */
+    void report(const char *name);
+};
+
+/**
+ * @brief Allocator drawing from PageArena, for std::allocate_shared. The standard library rebinds
+ * it to its own control block type, so the check below catches a library whose control block plus
+ * the object no longer fits a block.
+ */
+template <class T>
+struct ArenaAllocator
+{
+    typedef T value_type;
+
+    ArenaAllocator() = default;
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &) {}
+
+    T *allocate(size_t count) {
+        static_assert(sizeof(T) <= ARENA_BLOCK_SIZE, "ARENA_BLOCK_SIZE is too small for this standard library's shared_ptr control block");
+        return (T *) PageArena::getInstance().allocate(count * sizeof(T));
+    }
+
+    void deallocate(T *data, size_t count) {
+        PageArena::getInstance().deallocate(data, count * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U> &) const { return true; }
+
+    template <class U>
+    bool operator!=(const ArenaAllocator<U> &) const { return false; }
+};
+
+#endif
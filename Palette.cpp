@@ -0,0 +1,23 @@
+#include "Palette.h"
+
+// White, light grey, dark grey and black in each pixel format
+static const u32 shades[3][PALETTE_SIZE] = {
+    {0xFFFFFFFF, 0xFFCCCCCC, 0xFF777777, 0xFF000000},
+    {0xFFFF, 0xCE79, 0x73AE, 0x0000},
+    {0xFF, 0xCC, 0x77, 0x00}
+};
+
+Palette::Palette(int format) {
+    this->format = format;
+    update(0xE4);
+}
+
+void Palette::update(u8 value) {
+    for (int index = 0; index < PALETTE_SIZE; index++) {
+        colors[index] = encode(format, (value >> (index * 2)) & 0x03);
+    }
+}
+
+u32 Palette::encode(int format, int shade) {
+    return shades[format][shade];
+}
@@ -0,0 +1,71 @@
+/**
+ * @class Palette
+ * @brief Lookup table for one DMG palette register
+ * BGP, OBP0 and OBP1 each assign one of four shades to the four color indices. This class keeps
+ * the four shades already encoded in the frame buffer's pixel format, and is only rebuilt when
+ * the game writes the register, so every pixel is a single table lookup and store.
+ */
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include "global.h"
+#include "PixelKernels.h"
+
+#define BGP_ADDR 0xFF47
+#define OBP0_ADDR 0xFF48
+#define OBP1_ADDR 0xFF49
+
+#define PIXEL_RGBA8888 0 ///< 32-bit pixels, R, G, B and A bytes in memory order.
+#define PIXEL_RGB565 1   ///< 16-bit pixels, 5 bits red, 6 green, 5 blue.
+#define PIXEL_GRAY8 2    ///< 8-bit pixels, the shade's intensity.
+#define PIXEL_FORMAT PIXEL_RGBA8888 ///< Frame buffer format; the window can only show PIXEL_RGBA8888.
+
+#if PIXEL_FORMAT == PIXEL_RGBA8888
+typedef u32 Pixel;
+#elif PIXEL_FORMAT == PIXEL_RGB565
+typedef u16 Pixel;
+#else
+typedef u8 Pixel;
+#endif
+
+class Palette
+{
+private:
+    u32 colors[PALETTE_SIZE]; ///< Encoded pixel for each color index.
+    int format;               ///< One of the PIXEL_* constants.
+
+public:
+    /**
+     * @brief Construct a new Palette object holding the identity mapping.
+     *
+     * @param format One of the PIXEL_* constants.
+     */
+    Palette(int format = PIXEL_FORMAT);
+
+    /**
+     * @brief Rebuilds the table from a palette register value.
+     *
+     * @param value The register value, two bits per color index starting with index 0.
+     */
+    void update(u8 value);
+
+    /**
+     * @brief Encodes one of the four DMG shades in a pixel format.
+     *
+     * @param format One of the PIXEL_* constants.
+     * @param shade 0 for white up to 3 for black.
+     * @return u32 The pixel, in the low bits for formats narrower than 32 bits.
+     */
+    static u32 encode(int format, int shade);
+
+    /**
+     * @brief Get the table.
+     *
+     * @return const u32* The PALETTE_SIZE encoded pixels, indexed by color index.
+     */
+    const u32 *getColors() const {
+        return colors;
+    }
+};
+
+#endif
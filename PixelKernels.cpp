@@ -0,0 +1,113 @@
+#include "PixelKernels.h"
+#include <cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Pixel masks in screen order: leftmost pixel is bit 7, or bit 0 when flipped
+static const u8 pixelBits[2][TILE_SIZE] = {
+    {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01},
+    {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80}
+};
+
+void PixelKernels::decodeTile(const u8 *data, u8 *tile, bool xFlip) {
+    const u8 *bits = pixelBits[xFlip];
+#if defined(__AVX2__)
+    // Four rows per register: broadcast each bitplane byte across its row, then test one bit per lane
+    u64 bitRow;
+    std::memcpy(&bitRow, bits, TILE_SIZE);
+    const __m256i mask = _mm256_set1_epi64x(bitRow);
+    const __m256i one = _mm256_set1_epi8(1);
+    for (int row = 0; row < TILE_SIZE; row += 4) {
+        const u8 *rows = data + row * 2;
+        __m256i low = _mm256_setr_epi64x(rows[0] * 0x0101010101010101ULL, rows[2] * 0x0101010101010101ULL,
+                                         rows[4] * 0x0101010101010101ULL, rows[6] * 0x0101010101010101ULL);
+        __m256i high = _mm256_setr_epi64x(rows[1] * 0x0101010101010101ULL, rows[3] * 0x0101010101010101ULL,
+                                          rows[5] * 0x0101010101010101ULL, rows[7] * 0x0101010101010101ULL);
+        low = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(low, mask), mask), one);
+        high = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(high, mask), mask), one);
+        __m256i colors = _mm256_or_si256(low, _mm256_add_epi8(high, high));
+        _mm256_storeu_si256((__m256i *) (tile + row * TILE_SIZE), colors);
+    }
+#elif defined(__SSE2__)
+    // Two rows per register: broadcast each bitplane byte across its row, then test one bit per lane
+    u64 bitRow;
+    std::memcpy(&bitRow, bits, TILE_SIZE);
+    const __m128i mask = _mm_set1_epi64x(bitRow);
+    const __m128i one = _mm_set1_epi8(1);
+    for (int row = 0; row < TILE_SIZE; row += 2) {
+        const u8 *rows = data + row * 2;
+        __m128i low = _mm_set_epi64x(rows[2] * 0x0101010101010101ULL, rows[0] * 0x0101010101010101ULL);
+        __m128i high = _mm_set_epi64x(rows[3] * 0x0101010101010101ULL, rows[1] * 0x0101010101010101ULL);
+        low = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(low, mask), mask), one);
+        high = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(high, mask), mask), one);
+        __m128i colors = _mm_or_si128(low, _mm_add_epi8(high, high));
+        _mm_storeu_si128((__m128i *) (tile + row * TILE_SIZE), colors);
+    }
+#elif defined(__ARM_NEON)
+    // Two rows per register: vtst sets a lane to all ones when its pixel bit is set
+    const uint8x16_t mask = vcombine_u8(vld1_u8(bits), vld1_u8(bits));
+    const uint8x16_t one = vdupq_n_u8(1);
+    for (int row = 0; row < TILE_SIZE; row += 2) {
+        const u8 *rows = data + row * 2;
+        uint8x16_t low = vandq_u8(vtstq_u8(vcombine_u8(vdup_n_u8(rows[0]), vdup_n_u8(rows[2])), mask), one);
+        uint8x16_t high = vandq_u8(vtstq_u8(vcombine_u8(vdup_n_u8(rows[1]), vdup_n_u8(rows[3])), mask), one);
+        vst1q_u8(tile + row * TILE_SIZE, vorrq_u8(low, vshlq_n_u8(high, 1)));
+    }
+#else
+    for (int row = 0; row < TILE_SIZE; row++) {
+        for (int pixel = 0; pixel < TILE_SIZE; pixel++) {
+            u8 bit = bits[pixel];
+            tile[row * TILE_SIZE + pixel] = ((data[row * 2 + 1] & bit) ? 2 : 0) | ((data[row * 2] & bit) ? 1 : 0);
+        }
+    }
+#endif
+}
+
+template <>
+void PixelKernels::mapColors<u32>(const u8 *colors, int count, const u32 *palette, u32 *pixels) {
+    int i = 0;
+#if defined(__AVX2__)
+    // Eight pixels per shuffle: each index selects the four bytes of its palette entry
+    const __m256i table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) palette));
+    const __m256i spread = _mm256_set1_epi32(0x04040404);
+    const __m256i byteOffsets = _mm256_set1_epi32(0x03020100);
+    for (; i + 8 <= count; i += 8) {
+        __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *) (colors + i)));
+        __m256i control = _mm256_add_epi32(_mm256_mullo_epi32(indices, spread), byteOffsets);
+        _mm256_storeu_si256((__m256i *) (pixels + i), _mm256_shuffle_epi8(table, control));
+    }
+#elif defined(__SSE2__)
+    // Four pixels per iteration, selecting each palette entry where the index matches
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i entry0 = _mm_set1_epi32(palette[0]);
+    const __m128i entry1 = _mm_set1_epi32(palette[1]);
+    const __m128i entry2 = _mm_set1_epi32(palette[2]);
+    const __m128i entry3 = _mm_set1_epi32(palette[3]);
+    for (; i + 4 <= count; i += 4) {
+        __m128i indices = _mm_cvtsi32_si128(colors[i] | (colors[i + 1] << 8) | (colors[i + 2] << 16) | (colors[i + 3] << 24));
+        indices = _mm_unpacklo_epi16(_mm_unpacklo_epi8(indices, zero), zero);
+        __m128i result = _mm_and_si128(_mm_cmpeq_epi32(indices, zero), entry0);
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi32(indices, _mm_set1_epi32(1)), entry1));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi32(indices, _mm_set1_epi32(2)), entry2));
+        result = _mm_or_si128(result, _mm_and_si128(_mm_cmpeq_epi32(indices, _mm_set1_epi32(3)), entry3));
+        _mm_storeu_si128((__m128i *) (pixels + i), result);
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    // Eight pixels per iteration: each index selects the four bytes of its palette entry
+    const uint8x16_t table = vld1q_u8((const u8 *) palette);
+    const uint32x4_t byteOffsets = vdupq_n_u32(0x03020100);
+    for (; i + 8 <= count; i += 8) {
+        uint16x8_t indices = vmovl_u8(vld1_u8(colors + i));
+        uint32x4_t lowControl = vmlaq_n_u32(byteOffsets, vmovl_u16(vget_low_u16(indices)), 0x04040404);
+        uint32x4_t highControl = vmlaq_n_u32(byteOffsets, vmovl_u16(vget_high_u16(indices)), 0x04040404);
+        vst1q_u8((u8 *) (pixels + i), vqtbl1q_u8(table, vreinterpretq_u8_u32(lowControl)));
+        vst1q_u8((u8 *) (pixels + i + 4), vqtbl1q_u8(table, vreinterpretq_u8_u32(highControl)));
+    }
+#endif
+    for (; i < count; i++) {
+        pixels[i] = palette[colors[i]];
+    }
+}
@@ -0,0 +1,50 @@
+/**
+ * @class PixelKernels
+ * @brief Vectorised inner loops of the PPU
+ * These helpers expand 2bpp tile data into color indices and map color indices through a
+ * 4-entry palette into 32-bit pixels, several pixels per instruction. Each has an AVX2, SSE2 and
+ * NEON version picked at compile time, and a scalar fallback for other targets and pixel formats.
+ */
+#ifndef PIXELKERNELS_H
+#define PIXELKERNELS_H
+
+#include "global.h"
+
+#define TILE_SIZE 8       ///< Width and height of a tile in pixels.
+#define TILE_BYTES 16     ///< Bytes per tile, two bitplanes per row.
+#define PALETTE_SIZE 4    ///< Colors in a DMG palette.
+
+class PixelKernels
+{
+public:
+    /**
+     * @brief Expands a whole tile from its bitplanes into color indices.
+     *
+     * @param data The TILE_BYTES bytes of the tile, low then high bitplane for each row.
+     * @param tile Receives TILE_SIZE rows of TILE_SIZE color indices.
+     * @param xFlip true to store each row mirrored, rightmost pixel first.
+     */
+    static void decodeTile(const u8 *data, u8 *tile, bool xFlip);
+
+    /**
+     * @brief Maps color indices through a palette into pixels. 32-bit pixels are vectorised;
+     * narrower formats use this loop.
+     *
+     * @tparam PixelType u32, u16 or u8, matching the palette's pixel format.
+     * @param colors Color indices, 0-3.
+     * @param count Number of pixels.
+     * @param palette The PALETTE_SIZE pixel values.
+     * @param pixels Receives count pixels.
+     */
+    template <typename PixelType>
+    static void mapColors(const u8 *colors, int count, const u32 *palette, PixelType *pixels) {
+        for (int i = 0; i < count; i++) {
+            pixels[i] = (PixelType) palette[colors[i]];
+        }
+    }
+};
+
+template <>
+void PixelKernels::mapColors<u32>(const u8 *colors, int count, const u32 *palette, u32 *pixels);
+
+#endif
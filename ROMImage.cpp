@@ -0,0 +1,438 @@
+#include "ROMImage.h"
+#include "Cartridge.h"
+#include "HugePages.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define INFLATE_CHUNK_SIZE 0x10000
+#define GZIP_WINDOW_BITS (15 + 16)  ///< zlib window bits for a gzip wrapper.
+#define RAW_WINDOW_BITS (-15)       ///< zlib window bits for a bare deflate stream.
+#define ZIP_END_SIGNATURE 0x06054B50
+#define ZIP_CENTRAL_SIGNATURE 0x02014B50
+#define ZIP_LOCAL_SIGNATURE 0x04034B50
+#define ZIP64_MARKER 0xFFFFFFFF      ///< Size or offset moved to a zip64 extra field.
+#define MAX_ROM_SIZE (0x8000L << 8)  ///< Largest ROM a header size code can declare, 8 MB.
+
+/**
+ * @brief A cached image, or the pending result while one thread loads it.
+ */
+struct CachedImage
+{
+    std::weak_ptr<const ROMImage> image;
+    std::shared_future<std::shared_ptr<const ROMImage>> loading; ///< Valid only while the image is being loaded.
+};
+
+static std::map<std::string, CachedImage> images; ///< Loaded images, keyed by file identity
+static std::mutex imagesLock;                     ///< Guards images only, never held while loading
+
+/**
+ * @brief Reads a little-endian value from a zip or gzip structure.
+ */
+static u32 readLittleEndian(const u8 *data, int size) {
+    u32 value = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Get the lower-case extension of a file name, including the dot.
+ */
+static std::string getExtension(std::string fileName) {
+    std::string extension = std::filesystem::path(fileName).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+std::shared_ptr<const ROMImage> ROMImage::load(std::string fileName) {
+    // Identify the file by its resolved path, size and modification time, so an edited ROM is reloaded
+    std::error_code error;
+    std::string key = std::filesystem::weakly_canonical(fileName, error).string();
+    if (key.empty()) {
+        key = fileName;
+    }
+    auto fileBytes = std::filesystem::file_size(fileName, error);
+    if (!error) {
+        key += ":" + std::to_string(fileBytes) + ":" + std::to_string(getModifiedTime(fileName));
+    }
+
+    std::promise<std::shared_ptr<const ROMImage>> result;
+    {
+        std::unique_lock<std::mutex> lock(imagesLock);
+        auto cached = images.find(key);
+        if (cached != images.end()) {
+            // Another thread is loading the same file, so wait for its image instead of loading a second copy
+            if (cached->second.loading.valid()) {
+                std::shared_future<std::shared_ptr<const ROMImage>> loading = cached->second.loading;
+                lock.unlock();
+                return loading.get();
+            }
+            std::shared_ptr<const ROMImage> image = cached->second.image.lock();
+            if (image) {
+                return image;
+            }
+        }
+
+        // Forget images whose last cartridge is gone, including older versions of edited files
+        for (auto it = images.begin(); it != images.end();) {
+            bool unused = !it->second.loading.valid() && it->second.image.expired();
+            it = unused ? images.erase(it) : std::next(it);
+        }
+        images[key] = {{}, result.get_future().share()};
+    }
+
+    // Compressed files are inflated straight into the image; others are mapped, or read if they
+    // cannot be. Loads of different files run in parallel.
+    std::shared_ptr<ROMImage> loaded(new ROMImage());
+    std::string extension = getExtension(fileName);
+    bool compressed = (extension == ".gz" || extension == ".zip");
+    if (compressed ? !loaded->decompress(fileName, extension == ".zip") : (!loaded->map(fileName) && !loaded->read(fileName))) {
+        loaded.reset();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(imagesLock);
+        if (loaded) {
+            images[key] = {loaded, {}};
+        } else {
+            images.erase(key);
+        }
+    }
+    result.set_value(loaded);
+    return loaded;
+}
+
+bool ROMImage::map(std::string fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Only whole 16 KB banks can be mapped without padding
+    long fileBytes = fileInfo.st_size;
+    if (fileBytes < 0x8000 || fileBytes % ROM_BANK_SIZE != 0) {
+        close(fd);
+        return false;
+    }
+
+    // Copying large ROMs into anonymous huge pages costs a full read and a private copy per process
+    if (ROM_HUGE_PAGE_COPY && fileBytes >= HUGE_PAGE_SIZE) {
+        close(fd);
+        return false;
+    }
+
+    void *mapping = mmap(nullptr, fileBytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    // Random bank switches in large ROMs thrash the TLB; huge pages for file mappings depend on
+    // the kernel and file system, so report whether the advice was taken
+    if (fileBytes >= HUGE_PAGE_SIZE) {
+        if (!HugePages::advise(mapping, fileBytes)) {
+            printf("ROM mapping not advised for huge pages, using normal pages.\n");
+        }
+        HugePages::report("ROM", mapping, fileBytes);
+    }
+
+    data = (u8 *) mapping;
+    fileSize = fileBytes;
+    size = fileBytes;
+    mapped = true;
+    return true;
+}
+
+bool ROMImage::read(std::string fileName) {
+    //  Open ROM file
+    FILE *fp = fopen(fileName.c_str(), "rb");
+
+    if (!fp) {
+        printf("Cannot open file.\n");
+        return false;
+    }
+
+    // Determine file size
+    fileSize = std::filesystem::file_size(fileName);
+
+    // Load ROM into memory, padded to whole 16 KB banks so the MMU can map any bank directly
+    size = std::max(0x8000L, (fileSize + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE * ROM_BANK_SIZE);
+    data = HugePages::allocate(size);
+
+    if (data == NULL) {
+        printf("Unable to allocate memory.\n");
+        fclose(fp);
+        return false;
+    }
+
+    std::memset(data, 0xFF, size);
+    fread(data, 1, fileSize, fp);
+    fclose(fp);
+
+    // Shared between instances, so make any stray write fault instead of corrupting the others
+    mprotect(data, size, PROT_READ);
+    mapped = false;
+    HugePages::report("ROM", data, size);
+    return true;
+}
+
+bool ROMImage::findZipEntry(FILE *fp, long &offset, long &compressedSize, long &uncompressedSize, int &method, u32 &crc) {
+    // The end of central directory record sits in the last 64 KB + 22 bytes, before the archive comment
+    fseek(fp, 0, SEEK_END);
+    long archiveSize = ftell(fp);
+    long tailSize = std::min(archiveSize, 0x10000L + 22);
+    std::vector<u8> tail(tailSize);
+    fseek(fp, archiveSize - tailSize, SEEK_SET);
+    if ((long) fread(tail.data(), 1, tailSize, fp) != tailSize) {
+        return false;
+    }
+    long end = tailSize - 22;
+    while (end >= 0 && readLittleEndian(&tail[end], 4) != ZIP_END_SIGNATURE) {
+        end--;
+    }
+    if (end < 0) {
+        return false;
+    }
+
+    // Take the first .gb or .gbc entry in the central directory; zip64 archives are not supported
+    int entryCount = readLittleEndian(&tail[end + 10], 2);
+    long directorySize = readLittleEndian(&tail[end + 12], 4);
+    if (entryCount == 0xFFFF || readLittleEndian(&tail[end + 12], 4) == ZIP64_MARKER ||
+        readLittleEndian(&tail[end + 16], 4) == ZIP64_MARKER || directorySize > archiveSize) {
+        return false;
+    }
+    std::vector<u8> directory(directorySize);
+    fseek(fp, readLittleEndian(&tail[end + 16], 4), SEEK_SET);
+    if ((long) fread(directory.data(), 1, directorySize, fp) != directorySize) {
+        return false;
+    }
+    long position = 0;
+    for (int i = 0; i < entryCount && position + 46 <= directorySize; i++) {
+        const u8 *entry = &directory[position];
+        if (readLittleEndian(entry, 4) != ZIP_CENTRAL_SIGNATURE) {
+            return false;
+        }
+        int nameLength = readLittleEndian(entry + 28, 2);
+        std::string name((const char *) entry + 46, std::min<long>(nameLength, directorySize - position - 46));
+        std::string extension = getExtension(name);
+        if (extension == ".gb" || extension == ".gbc") {
+            method = readLittleEndian(entry + 10, 2);
+            crc = readLittleEndian(entry + 16, 4);
+            compressedSize = readLittleEndian(entry + 20, 4);
+            uncompressedSize = readLittleEndian(entry + 24, 4);
+            long localHeader = readLittleEndian(entry + 42, 4);
+            if (compressedSize == ZIP64_MARKER || uncompressedSize == ZIP64_MARKER || localHeader == ZIP64_MARKER) {
+                return false;
+            }
+
+            // The local header repeats the name and may carry a different extra field
+            u8 local[30];
+            fseek(fp, localHeader, SEEK_SET);
+            if (fread(local, 1, sizeof(local), fp) != sizeof(local) || readLittleEndian(local, 4) != ZIP_LOCAL_SIGNATURE) {
+                return false;
+            }
+            offset = localHeader + 30 + readLittleEndian(local + 26, 2) + readLittleEndian(local + 28, 2);
+            return true;
+        }
+        position += 46 + nameLength + readLittleEndian(entry + 30, 2) + readLittleEndian(entry + 32, 2);
+    }
+    return false;
+}
+
+bool ROMImage::findCompressedROM(FILE *fp, std::string fileName, bool zip, CompressedROM &rom) {
+    if (zip) {
+        if (!findZipEntry(fp, rom.offset, rom.compressedSize, rom.uncompressedSize, rom.method, rom.crc) ||
+            (rom.method != ZIP_STORED && rom.method != ZIP_DEFLATED)) {
+            printf("No stored or deflated ROM entry in %s.\n", fileName.c_str());
+            return false;
+        }
+    } else {
+        // gzip keeps the uncompressed size (mod 4 GB) in its last four bytes
+        u8 trailer[4];
+        fseek(fp, 0, SEEK_END);
+        rom.offset = 0;
+        rom.compressedSize = ftell(fp);
+        rom.method = ZIP_DEFLATED;
+        fseek(fp, -4, SEEK_END);
+        if (rom.compressedSize < 18 || fread(trailer, 1, 4, fp) != 4) {
+            return false;
+        }
+        rom.uncompressedSize = readLittleEndian(trailer, 4);
+    }
+    // The sizes come from the file itself, so never trust them beyond what a ROM can be
+    if (rom.uncompressedSize < 0x150 || rom.uncompressedSize > MAX_ROM_SIZE) {
+        printf("%s does not hold a ROM of a valid size.\n", fileName.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool ROMImage::decompress(std::string fileName, bool zip) {
+    FILE *fp = fopen(fileName.c_str(), "rb");
+    if (!fp) {
+        printf("Cannot open file.\n");
+        return false;
+    }
+
+    // Find the compressed stream and the size it expands to
+    CompressedROM rom;
+    if (!findCompressedROM(fp, fileName, zip, rom)) {
+        fclose(fp);
+        return false;
+    }
+
+    fileSize = rom.uncompressedSize;
+    size = std::max(0x8000L, (fileSize + ROM_BANK_SIZE - 1) / ROM_BANK_SIZE * ROM_BANK_SIZE);
+    data = HugePages::allocate(size);
+    if (data == NULL) {
+        printf("Unable to allocate memory.\n");
+        fclose(fp);
+        return false;
+    }
+    std::memset(data + fileSize, 0xFF, size - fileSize);
+
+    bool valid = inflateROM(fp, fileName, zip, rom, data);
+    fclose(fp);
+    if (!valid) {
+        HugePages::release(data, size);
+        data = nullptr;
+        return false;
+    }
+
+    mprotect(data, size, PROT_READ);
+    mapped = false;
+    HugePages::report("ROM", data, size);
+    return true;
+}
+
+bool ROMImage::decompress(std::string fileName, std::vector<u8> &data) {
+    FILE *fp = fopen(fileName.c_str(), "rb");
+    if (!fp) {
+        printf("Cannot open file.\n");
+        return false;
+    }
+
+    bool zip = getExtension(fileName) == ".zip";
+    CompressedROM rom;
+    bool valid = findCompressedROM(fp, fileName, zip, rom);
+    if (valid) {
+        data.resize(rom.uncompressedSize);
+        valid = inflateROM(fp, fileName, zip, rom, data.data());
+    }
+    fclose(fp);
+    return valid;
+}
+
+bool ROMImage::inflateROM(FILE *fp, std::string fileName, bool zip, const CompressedROM &rom, u8 *data) {
+    long fileSize = rom.uncompressedSize;
+    int method = rom.method;
+    z_stream stream = {};
+    if (method == ZIP_DEFLATED && inflateInit2(&stream, zip ? RAW_WINDOW_BITS : GZIP_WINDOW_BITS) != Z_OK) {
+        return false;
+    }
+    stream.next_out = data;
+    stream.avail_out = fileSize;
+
+    // Inflate chunk by chunk straight into the buffer, checking the header as soon as it is out
+    fseek(fp, rom.offset, SEEK_SET);
+    std::vector<u8> chunk(INFLATE_CHUNK_SIZE);
+    long remaining = rom.compressedSize - (zip ? 0 : rom.offset);
+    bool headerChecked = false;
+    bool valid = true;
+    bool finished = false;
+    int result = Z_OK;
+    while (!finished && remaining > 0) {
+        size_t length = fread(chunk.data(), 1, std::min<long>(chunk.size(), remaining), fp);
+        if (length == 0) {
+            break;
+        }
+        remaining -= length;
+        if (method == ZIP_STORED) {
+            size_t copied = std::min<size_t>(length, stream.avail_out);
+            std::memcpy(stream.next_out, chunk.data(), copied);
+            stream.next_out += copied;
+            stream.avail_out -= copied;
+            finished = stream.avail_out == 0;
+        } else {
+            stream.next_in = chunk.data();
+            stream.avail_in = length;
+            // Run to the end of the stream, so zlib checks the gzip trailer and longer streams are caught
+            result = inflate(&stream, Z_NO_FLUSH);
+            finished = result == Z_STREAM_END;
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                break;
+            }
+        }
+
+        long produced = fileSize - stream.avail_out;
+        if (!headerChecked && produced >= 0x150) {
+            headerChecked = true;
+            if (Cartridge::getHeaderChecksum(data) != data[0x014D] || data[0x0148] > 0x08) {
+                printf("Invalid ROM header in %s.\n", fileName.c_str());
+                valid = false;
+                break;
+            }
+        }
+    }
+    if (method == ZIP_DEFLATED) {
+        inflateEnd(&stream);
+    }
+
+    if (valid && (!headerChecked || stream.avail_out != 0 || (method == ZIP_DEFLATED && result != Z_STREAM_END))) {
+        printf("Cannot decompress %s.\n", fileName.c_str());
+        valid = false;
+    }
+    if (valid && zip && crc32(0, data, fileSize) != rom.crc) {
+        printf("CRC mismatch in %s.\n", fileName.c_str());
+        valid = false;
+    }
+    return valid;
+}
+
+u64 ROMImage::getModifiedTime(std::string fileName) {
+    std::error_code error;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(fileName, error);
+    if (error) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(modified.time_since_epoch()).count();
+}
+
+ROMImage::~ROMImage() {
+    if (mapped) {
+        munmap(data, size);
+    } else {
+        HugePages::release(data, size);
+    }
+}
+
+u8 *ROMImage::getData() const {
+    return data;
+}
+
+long ROMImage::getSize() const {
+    return size;
+}
+
+long ROMImage::getFileSize() const {
+    return fileSize;
+}
@@ -0,0 +1,156 @@
+/**
+ * @class ROMImage
+ * @brief Immutable ROM file contents shared by every cartridge loading the same file
+ * Images are cached by file path, size and modification time, so any number of emulator
+ * instances in one process map a single copy of the ROM. The image is freed when the last
+ * cartridge holding it is destroyed. Only RAM, registers and mapper state are per instance.
+ */
+#ifndef ROMIMAGE_H
+#define ROMIMAGE_H
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "global.h"
+
+#define ZIP_STORED 0
+#define ZIP_DEFLATED 8
+#define ROM_HUGE_PAGE_COPY 0 ///< 1 to copy ROMs of 2 MB or more into private huge pages instead of mapping the file.
+
+/**
+ * @brief Where a compressed ROM sits in its file and what it expands to.
+ */
+struct CompressedROM
+{
+    long offset = 0;           ///< File offset of the compressed stream.
+    long compressedSize = 0;   ///< Size of the compressed stream, or of the whole file for gzip.
+    long uncompressedSize = 0; ///< Size of the ROM, checked against the largest valid ROM.
+    int method = ZIP_DEFLATED; ///< Zip compression method; gzip is always deflate.
+    u32 crc = 0;               ///< CRC-32 of the ROM from a zip directory; gzip checks its own.
+};
+
+class ROMImage
+{
+private:
+    u8 *data = nullptr;  ///< ROM bytes, padded to whole 16 KB banks. Never written after loading.
+    long fileSize = 0;   ///< Size of the ROM file in bytes.
+    long size = 0;       ///< Size of data in bytes.
+    bool mapped = false; ///< Whether data is a read-only mapping of the file rather than a copy.
+
+    /**
+     * @brief Maps the ROM file read-only into memory, the default for whole-bank ROMs. Pages are
+     * faulted in as they are touched and shared with every other process mapping the same file.
+     * Mappings of 2 MB or more are advised for huge pages.
+     *
+     * @param fileName Name of the ROM file.
+     * @return true if the file was mapped, false if it must be read instead.
+     */
+    bool map(std::string fileName);
+
+    /**
+     * @brief Reads the ROM file into a read-only buffer padded to whole 16 KB banks, backed by
+     * huge pages when it is large enough. Used for files that cannot be mapped, and for large
+     * ROMs when ROM_HUGE_PAGE_COPY is set.
+     *
+     * @param fileName Name of the ROM file.
+     * @return true if the file could be read, false otherwise.
+     */
+    bool read(std::string fileName);
+
+    /**
+     * @brief Inflates a .gz file or the first .gb/.gbc entry of a .zip file straight into a
+     * buffer padded to whole 16 KB banks, in one pass and without temporary files.
+     *
+     * @param fileName Name of the compressed file.
+     * @param zip true for a zip archive, false for gzip.
+     * @return true if a valid ROM was decompressed.
+     */
+    bool decompress(std::string fileName, bool zip);
+
+    /**
+     * @brief Finds the compressed ROM in an open .gz or .zip file and checks its size.
+     *
+     * @param fp The open file.
+     * @param fileName Name of the file, for messages.
+     * @param zip true for a zip archive, false for gzip.
+     * @param rom Set to the location and size of the ROM.
+     * @return true if a ROM of a valid size was found.
+     */
+    static bool findCompressedROM(FILE *fp, std::string fileName, bool zip, CompressedROM &rom);
+
+    /**
+     * @brief Inflates a compressed ROM into a buffer of its uncompressed size. The header is
+     * validated as soon as it is decompressed, so bad files are rejected early.
+     *
+     * @param fp The open file.
+     * @param fileName Name of the file, for messages.
+     * @param zip true for a zip archive, false for gzip.
+     * @param rom The ROM found by findCompressedROM.
+     * @param data Buffer of at least rom.uncompressedSize bytes.
+     * @return true if a valid ROM was decompressed.
+     */
+    static bool inflateROM(FILE *fp, std::string fileName, bool zip, const CompressedROM &rom, u8 *data);
+
+    /**
+     * @brief Finds the first ROM entry in a zip archive.
+     *
+     * @param fp The open archive.
+     * @param offset Set to the file offset of the entry data.
+     * @param compressedSize Set to the size of the entry data.
+     * @param uncompressedSize Set to the size of the ROM.
+     * @param method Set to the zip compression method.
+     * @param crc Set to the CRC-32 of the ROM.
+     * @return true if a .gb or .gbc entry was found in an archive without zip64 extensions.
+     */
+    static bool findZipEntry(FILE *fp, long &offset, long &compressedSize, long &uncompressedSize, int &method, u32 &crc);
+
+public:
+    /**
+     * @brief Destroy the ROMImage object and unmap its data.
+     */
+    ~ROMImage();
+
+    /**
+     * @brief Get the image of a ROM file, loading it unless another cartridge already holds it.
+     * Threads asking for a file that is still loading wait for that load; other files load in parallel.
+     *
+     * @param fileName Name of the ROM file.
+     * @return The shared image, or nullptr if the file cannot be loaded.
+     */
+    static std::shared_ptr<const ROMImage> load(std::string fileName);
+
+    /**
+     * @brief Inflates a .gz or .zip ROM into a private buffer, bypassing the image cache.
+     *
+     * @param fileName Name of the compressed file.
+     * @param data Set to the ROM bytes, without padding.
+     * @return true if a valid ROM was decompressed.
+     */
+    static bool decompress(std::string fileName, std::vector<u8> &data);
+
+    /**
+     * @brief Get the modification time of a file, for telling edited files apart.
+     *
+     * @param fileName Name of the file.
+     * @return u64 Nanoseconds on the file system clock, or 0 if the file cannot be read.
+     */
+    static u64 getModifiedTime(std::string fileName);
+
+    /**
+     * @brief Get the ROM bytes. The memory is read-only.
+     */
+    u8 *getData() const;
+
+    /**
+     * @brief Get the size of the ROM data, always a whole number of 16 KB banks.
+     */
+    long getSize() const;
+
+    /**
+     * @brief Get the size of the ROM file in bytes.
+     */
+    long getFileSize() const;
+};
+
+#endif
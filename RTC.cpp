@@ -0,0 +1,163 @@
+#include "RTC.h"
+#include <chrono>
+#include <algorithm>
+
+#define RTC_PERIOD (512 * (u64) SECONDS_PER_DAY) ///< The day counter wraps after 512 days.
+
+/**
+ * @brief Reads a little-endian value from the save block.
+ */
+static u64 readLittleEndian(const u8 *data, int size) {
+    u64 value = 0;
+    for (int i = size - 1; i >= 0; i--) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+/**
+ * @brief Writes a little-endian value to the save block.
+ */
+static void writeLittleEndian(u8 *data, int size, u64 value) {
+    for (int i = 0; i < size; i++) {
+        data[i] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+/**
+ * @brief Get the host time in seconds since the epoch.
+ */
+static u64 getUnixTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+RTC::RTC(u8 *saveBlock, int mode) {
+    this->saveBlock = saveBlock;
+    this->mode = mode;
+    load();
+}
+
+RTC::~RTC() {
+    save();
+}
+
+u64 RTC::getTicks() {
+    if (mode == RTC_EMULATED) {
+        return cycleCounter ? *cycleCounter : 0;
+    }
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+u64 RTC::getTicksPerSecond() {
+    return (mode == RTC_EMULATED) ? CPU_CLOCK_SPEED / 4 : 1000;
+}
+
+u64 RTC::getSeconds() {
+    if (halted) {
+        return baseSeconds;
+    }
+    // The host clock may have been set back
+    u64 ticks = getTicks();
+    u64 ticksPerSecond = getTicksPerSecond();
+    u64 elapsed = (ticks > baseTicks) ? (ticks - baseTicks) / ticksPerSecond : 0;
+    u64 seconds = baseSeconds + elapsed;
+    if (seconds >= RTC_PERIOD) {
+        carry = true;
+        seconds %= RTC_PERIOD;
+        baseSeconds = seconds;
+        baseTicks += elapsed * ticksPerSecond;
+    }
+    return seconds;
+}
+
+void RTC::getRegisters(u64 seconds, u8 *registers) {
+    u64 days = seconds / SECONDS_PER_DAY;
+    registers[0] = seconds % 60;
+    registers[1] = (seconds / 60) % 60;
+    registers[2] = (seconds / 3600) % 24;
+    registers[3] = days & 0xFF;
+    registers[4] = ((days >> 8) & 0x01) | (halted ? RTC_HALT : 0) | (carry ? RTC_CARRY : 0);
+}
+
+void RTC::rebase(u64 seconds) {
+    baseSeconds = seconds;
+    baseTicks = getTicks();
+}
+
+void RTC::setCycleCounter(const u64 *cycleCounter) {
+    u64 seconds = getSeconds();
+    this->cycleCounter = cycleCounter;
+    rebase(seconds);
+}
+
+void RTC::writeLatch(u8 data) {
+    if (latchWrite == 0x00 && data == 0x01) {
+        getRegisters(getSeconds(), latched);
+    }
+    latchWrite = data;
+}
+
+u8 RTC::readRegister(u8 reg) {
+    return latched[reg - RTC_SECONDS];
+}
+
+void RTC::writeRegister(u8 reg, u8 data) {
+    u8 registers[5];
+    getRegisters(getSeconds(), registers);
+    registers[reg - RTC_SECONDS] = data;
+
+    halted = registers[4] & RTC_HALT;
+    carry = registers[4] & RTC_CARRY;
+    u64 days = registers[3] | ((registers[4] & 0x01) << 8);
+    rebase((registers[0] & 0x3F) + (registers[1] & 0x3F) * 60 + (registers[2] & 0x1F) * 3600 + days * SECONDS_PER_DAY);
+}
+
+void RTC::save() {
+    u8 registers[5];
+    getRegisters(getSeconds(), registers);
+    for (int i = 0; i < 5; i++) {
+        writeLittleEndian(saveBlock + i * 4, 4, registers[i]);
+        writeLittleEndian(saveBlock + 20 + i * 4, 4, latched[i]);
+    }
+    writeLittleEndian(saveBlock + 40, 8, getUnixTime());
+}
+
+RTCState RTC::saveState() {
+    RTCState state = {baseSeconds, baseTicks, halted, carry, {}, latchWrite};
+    std::copy(latched, latched + 5, state.latched);
+    return state;
+}
+
+void RTC::loadState(const RTCState &state) {
+    baseSeconds = state.baseSeconds;
+    baseTicks = state.baseTicks;
+    halted = state.halted;
+    carry = state.carry;
+    std::copy(state.latched, state.latched + 5, latched);
+    latchWrite = state.latchWrite;
+}
+
+void RTC::load() {
+    u8 registers[5];
+    for (int i = 0; i < 5; i++) {
+        registers[i] = readLittleEndian(saveBlock + i * 4, 4);
+        latched[i] = readLittleEndian(saveBlock + 20 + i * 4, 4);
+    }
+    halted = registers[4] & RTC_HALT;
+    carry = registers[4] & RTC_CARRY;
+    u64 days = registers[3] | ((registers[4] & 0x01) << 8);
+    u64 seconds = registers[0] + registers[1] * 60 + registers[2] * 3600 + days * SECONDS_PER_DAY;
+
+    // A wall clock kept running while the emulator was closed
+    u64 savedTime = readLittleEndian(saveBlock + 40, 8);
+    u64 now = getUnixTime();
+    if (mode == RTC_WALL_CLOCK && !halted && savedTime != 0 && now > savedTime) {
+        seconds += now - savedTime;
+        if (seconds >= RTC_PERIOD) {
+            carry = true;
+            seconds %= RTC_PERIOD;
+        }
+    }
+    rebase(seconds);
+}
@@ -0,0 +1,155 @@
+/**
+ * @class RTC
+ * @brief MBC3 real-time clock
+ * This class derives the clock registers from a base time and the time elapsed since, only when
+ * the game latches or writes them, so nothing is ticked while the game runs. Time is taken either
+ * from the emulated cycle count (deterministic, for replays) or from the host wall clock. The
+ * clock is persisted in the 48-byte block most emulators append to the save file.
+ */
+#ifndef RTC_H
+#define RTC_H
+
+#include "global.h"
+
+#define RTC_EMULATED 0   ///< Clock advances with emulated cycles.
+#define RTC_WALL_CLOCK 1 ///< Clock advances with host time, including while the emulator is closed.
+#define RTC_MODE RTC_WALL_CLOCK ///< Time source for cartridge clocks, RTC_EMULATED for deterministic replays.
+
+#define RTC_SECONDS 0x08 ///< First clock register, selected like a RAM bank.
+#define RTC_DAYS_HIGH 0x0C ///< Last clock register: day bit 8, halt and day carry.
+#define RTC_HALT 0x40
+#define RTC_CARRY 0x80
+#define SECONDS_PER_DAY 86400
+
+/**
+ * @brief A copy of the clock state, for snapshots.
+ */
+struct RTCState
+{
+    u64 baseSeconds;
+    u64 baseTicks;
+    bool halted;
+    bool carry;
+    u8 latched[5];
+    u8 latchWrite;
+};
+
+class RTC
+{
+private:
+    u8 *saveBlock;            ///< Clock block in the save file.
+    int mode;                 ///< RTC_EMULATED or RTC_WALL_CLOCK.
+    const u64 *cycleCounter = nullptr; ///< Emulated cycle count, used in RTC_EMULATED mode.
+
+    u64 baseSeconds = 0;      ///< Clock value, in seconds since day 0, at baseTicks.
+    u64 baseTicks = 0;        ///< Time source reading when baseSeconds was set.
+    bool halted = false;      ///< Whether the clock is stopped.
+    bool carry = false;       ///< Day counter overflow flag.
+    u8 latched[5] = {};       ///< Registers 0x08-0x0C as of the last latch.
+    u8 latchWrite = 0xFF;     ///< Last value written to the latch register.
+
+    /**
+     * @brief Reads the time source.
+     *
+     * @return u64 M-cycles in RTC_EMULATED mode, milliseconds since the epoch in RTC_WALL_CLOCK mode.
+     */
+    u64 getTicks();
+
+    /**
+     * @brief Get the number of time source ticks in a second.
+     */
+    u64 getTicksPerSecond();
+
+    /**
+     * @brief Computes the current clock value, setting the carry flag if the day counter overflowed.
+     *
+     * @return u64 Seconds since day 0, below 512 days.
+     */
+    u64 getSeconds();
+
+    /**
+     * @brief Splits a clock value into the five clock registers.
+     *
+     * @param seconds Seconds since day 0.
+     * @param registers Filled with registers 0x08-0x0C.
+     */
+    void getRegisters(u64 seconds, u8 *registers);
+
+    /**
+     * @brief Restarts the clock from a value at the current time.
+     *
+     * @param seconds Seconds since day 0.
+     */
+    void rebase(u64 seconds);
+
+    /**
+     * @brief Loads the clock from the save block, adding the host time since it was written in
+     * RTC_WALL_CLOCK mode.
+     */
+    void load();
+
+public:
+    /**
+     * @brief Construct a new RTC object from its save block.
+     *
+     * @param saveBlock RTC_SAVE_SIZE bytes of clock state, all zero for a new clock.
+     * @param mode RTC_EMULATED or RTC_WALL_CLOCK.
+     */
+    RTC(u8 *saveBlock, int mode);
+
+    /**
+     * @brief Writes the clock back to its save block.
+     */
+    ~RTC();
+
+    /**
+     * @brief Sets the emulated cycle count the clock follows in RTC_EMULATED mode.
+     *
+     * @param cycleCounter Cycles emulated since power on.
+     */
+    void setCycleCounter(const u64 *cycleCounter);
+
+    /**
+     * @brief Handles a write to 0x6000-0x7FFF. Writing 0x00 then 0x01 latches the registers.
+     *
+     * @param data The 8-bit data written.
+     */
+    void writeLatch(u8 data);
+
+    /**
+     * @brief Reads a latched clock register.
+     *
+     * @param reg Register number, RTC_SECONDS to RTC_DAYS_HIGH.
+     * @return u8 The register value.
+     */
+    u8 readRegister(u8 reg);
+
+    /**
+     * @brief Sets a clock register.
+     *
+     * @param reg Register number, RTC_SECONDS to RTC_DAYS_HIGH.
+     * @param data The 8-bit data written.
+     */
+    void writeRegister(u8 reg, u8 data);
+
+    /**
+     * @brief Stores the current clock and host time in the save block.
+     */
+    void save();
+
+    /**
+     * @brief Copies the clock base, flags and latched registers.
+     *
+     * @return RTCState The current state.
+     */
+    RTCState saveState();
+
+    /**
+     * @brief Restores the clock. In RTC_EMULATED mode the cycle count must be restored with it.
+     *
+     * @param state A state returned by saveState.
+     */
+    void loadState(const RTCState &state);
+};
+
+#endif
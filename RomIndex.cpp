@@ -0,0 +1,245 @@
+#include "RomIndex.h"
+#include "Cartridge.h"
+#include "ROMImage.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SCAN_CHUNK_SIZE 0x10000
+#define FNV_OFFSET 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+static_assert(sizeof(RomIndexEntry) % 8 == 0, "Index records must keep their 64-bit fields aligned");
+
+/**
+ * @brief Get the lower-case extension of a file name, including the dot.
+ */
+static std::string getExtension(const std::filesystem::path &fileName) {
+    std::string extension = fileName.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension;
+}
+
+bool RomIndex::scanFile(std::string fileName, RomIndexEntry &entry) {
+    // Hash and sum the whole ROM in one pass; the header sits in the first chunk
+    u8 header[0x150];
+    u64 hash = FNV_OFFSET;
+    u16 sum = 0;
+    size_t offset = 0;
+    auto scan = [&](const u8 *data, size_t length) {
+        if (offset == 0 && length >= sizeof(header)) {
+            std::memcpy(header, data, sizeof(header));
+        }
+        for (size_t i = 0; i < length; i++) {
+            hash = (hash ^ data[i]) * FNV_PRIME;
+            sum += data[i];
+        }
+        offset += length;
+    };
+
+    std::string extension = getExtension(fileName);
+    if (extension == ".gz" || extension == ".zip") {
+        // Compressed ROMs are inflated by the emulator's code into a buffer of this worker's own
+        std::vector<u8> rom;
+        if (!ROMImage::decompress(fileName, rom)) {
+            return false;
+        }
+        scan(rom.data(), rom.size());
+    } else {
+        FILE *fp = fopen(fileName.c_str(), "rb");
+        if (!fp) {
+            return false;
+        }
+        std::vector<u8> chunk(SCAN_CHUNK_SIZE);
+        size_t length;
+        while ((length = fread(chunk.data(), 1, chunk.size(), fp)) > 0) {
+            scan(chunk.data(), length);
+        }
+        fclose(fp);
+    }
+    if (offset < sizeof(header)) {
+        return false;
+    }
+
+    // The global checksum covers every byte except its own two
+    GBHeader parsed = Cartridge::getHeader(header);
+    sum -= header[0x014E] + header[0x014F];
+    std::memcpy(entry.title, parsed.title, sizeof(entry.title));
+    entry.contentHash = hash;
+    entry.cartridgeType = parsed.cartridgeType;
+    entry.mapper = Cartridge::getMapperType(parsed.cartridgeType);
+    entry.licenseCode = parsed.licenseCode;
+    entry.romSizeCode = parsed.romSizeCode;
+    entry.ramSizeCode = parsed.ramSizeCode;
+    entry.romSize = (parsed.romSizeCode <= 0x08) ? (0x8000 << parsed.romSizeCode) : 0;
+    entry.ramSize = (entry.mapper == MBC_2) ? MBC2_RAM_SIZE : Cartridge::getRAMSize(parsed.ramSizeCode);
+    entry.headerChecksum = parsed.headerChecksum;
+    entry.headerValid = Cartridge::getHeaderChecksum(header) == parsed.headerChecksum;
+    entry.globalChecksum = parsed.globalChecksum;
+    entry.globalValid = sum == parsed.globalChecksum;
+    return true;
+}
+
+bool RomIndex::build(std::string directory, std::string indexFile, int *scanned) {
+    // Records of the previous index, reused for unchanged files
+    std::map<std::string, RomIndexEntry> previous;
+    RomIndex existing;
+    if (existing.open(indexFile)) {
+        for (u32 i = 0; i < existing.size(); i++) {
+            previous[existing.getEntry(i).path] = existing.getEntry(i);
+        }
+    }
+
+    std::vector<RomIndexEntry> entries;
+    std::vector<size_t> changed;
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(directory, error);
+    if (error) {
+        printf("Cannot scan directory %s.\n", directory.c_str());
+        return false;
+    }
+    for (; it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+        std::string extension = getExtension(it->path());
+        bool rom = extension == ".gb" || extension == ".gbc" || extension == ".gz" || extension == ".zip";
+        if (error || !it->is_regular_file() || !rom) {
+            continue;
+        }
+        std::string path = std::filesystem::relative(it->path(), directory).string();
+        auto fileBytes = it->file_size(error);
+        if (path.size() >= ROM_INDEX_PATH_SIZE || error) {
+            continue;
+        }
+
+        RomIndexEntry entry = {};
+        std::strcpy(entry.path, path.c_str());
+        entry.modifiedTime = ROMImage::getModifiedTime(it->path().string());
+        entry.fileSize = fileBytes;
+        auto old = previous.find(path);
+        if (old != previous.end() && old->second.modifiedTime == entry.modifiedTime && old->second.fileSize == entry.fileSize) {
+            entry = old->second;
+        } else {
+            changed.push_back(entries.size());
+        }
+        entries.push_back(entry);
+    }
+
+    // Read new and modified files on every core
+    std::atomic<size_t> next(0);
+    std::vector<u8> valid(entries.size(), 1);
+    std::vector<std::thread> workers;
+    int threadCount = std::max(1u, std::thread::hardware_concurrency());
+    for (int i = 0; i < threadCount; i++) {
+        workers.emplace_back([&]() {
+            for (size_t job = next++; job < changed.size(); job = next++) {
+                RomIndexEntry &entry = entries[changed[job]];
+                valid[changed[job]] = scanFile((std::filesystem::path(directory) / entry.path).string(), entry);
+            }
+        });
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+
+    std::vector<RomIndexEntry> records;
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (valid[i]) {
+            records.push_back(entries[i]);
+        }
+    }
+    std::sort(records.begin(), records.end(), [](const RomIndexEntry &a, const RomIndexEntry &b) {
+        return std::strcmp(a.path, b.path) < 0;
+    });
+
+    // Write a new file and rename it over the old one, so open mappings stay valid
+    std::string tempFile = indexFile + ".tmp";
+    FILE *fp = fopen(tempFile.c_str(), "wb");
+    if (!fp) {
+        printf("Cannot write index file %s.\n", tempFile.c_str());
+        return false;
+    }
+    RomIndexHeader header = {};
+    std::memcpy(header.magic, ROM_INDEX_MAGIC, sizeof(header.magic));
+    header.entrySize = sizeof(RomIndexEntry);
+    header.count = records.size();
+    bool written = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+                   fwrite(records.data(), sizeof(RomIndexEntry), records.size(), fp) == records.size();
+    written = (fclose(fp) == 0) && written;
+    if (!written || std::rename(tempFile.c_str(), indexFile.c_str()) != 0) {
+        printf("Cannot write index file %s.\n", indexFile.c_str());
+        std::remove(tempFile.c_str());
+        return false;
+    }
+
+    if (scanned) {
+        *scanned = changed.size();
+    }
+    return true;
+}
+
+bool RomIndex::open(std::string indexFile) {
+    int fd = ::open(indexFile.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat fileInfo;
+    if (fstat(fd, &fileInfo) != 0 || (size_t) fileInfo.st_size < sizeof(RomIndexHeader)) {
+        close(fd);
+        return false;
+    }
+    void *data = mmap(nullptr, fileInfo.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    const RomIndexHeader *header = (const RomIndexHeader *) data;
+    if (std::memcmp(header->magic, ROM_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->entrySize != sizeof(RomIndexEntry) ||
+        sizeof(RomIndexHeader) + (size_t) header->count * sizeof(RomIndexEntry) > (size_t) fileInfo.st_size) {
+        munmap(data, fileInfo.st_size);
+        return false;
+    }
+
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+    mapping = (u8 *) data;
+    mappingSize = fileInfo.st_size;
+    entries = (const RomIndexEntry *) (mapping + sizeof(RomIndexHeader));
+    count = header->count;
+    return true;
+}
+
+RomIndex::~RomIndex() {
+    if (mapping) {
+        munmap(mapping, mappingSize);
+    }
+}
+
+u32 RomIndex::size() {
+    return count;
+}
+
+const RomIndexEntry &RomIndex::getEntry(u32 index) {
+    return entries[index];
+}
+
+const RomIndexEntry *RomIndex::find(std::string path) {
+    const RomIndexEntry *end = entries + count;
+    const RomIndexEntry *entry = std::lower_bound(entries, end, path, [](const RomIndexEntry &a, const std::string &path) {
+        return std::strcmp(a.path, path.c_str()) < 0;
+    });
+    if (entry == end || path != entry->path) {
+        return nullptr;
+    }
+    return entry;
+}
@@ -0,0 +1,115 @@
+/**
+ * @class RomIndex
+ * @brief Catalog of the ROMs in a directory tree
+ * The index file holds one fixed-size record per ROM with its parsed header, checksums, sizes
+ * and a content hash, so catalog queries never open the ROMs themselves. Building scans the tree
+ * with one thread per core and only re-reads files whose size or modification time changed.
+ * The file is a plain array of records, so opening it is a single read-only mmap.
+ */
+#ifndef ROMINDEX_H
+#define ROMINDEX_H
+
+#include <string>
+#include "global.h"
+
+#define ROM_INDEX_MAGIC "GBPPIDX1"
+#define ROM_INDEX_PATH_SIZE 256
+
+/**
+ * @brief The index file header, followed by count RomIndexEntry records sorted by path.
+ */
+struct RomIndexHeader
+{
+    char magic[8]; ///< ROM_INDEX_MAGIC.
+    u32 entrySize; ///< sizeof(RomIndexEntry), so a changed layout is rebuilt rather than misread.
+    u32 count;     ///< Number of records.
+};
+
+/**
+ * @brief One ROM in the index.
+ */
+struct RomIndexEntry
+{
+    char path[ROM_INDEX_PATH_SIZE]; ///< Path relative to the indexed directory.
+    u64 modifiedTime;   ///< File modification time, see ROMImage::getModifiedTime.
+    u64 fileSize;       ///< Size of the file in bytes.
+    u64 contentHash;    ///< 64-bit FNV-1a hash of the (decompressed) ROM contents.
+    char title[16];     ///< Title from 0x0134, not NUL terminated if 16 characters long.
+    u32 romSize;        ///< ROM size the header declares.
+    u32 ramSize;        ///< External RAM size the header declares, 512 for MBC2.
+    u16 licenseCode;    ///< License code at 0x0144.
+    u16 globalChecksum; ///< Global checksum stored at 0x014E.
+    u8 cartridgeType;   ///< Cartridge type byte at 0x0147.
+    u8 mapper;          ///< One of the MBC_* constants.
+    u8 romSizeCode;     ///< ROM size code at 0x0148.
+    u8 ramSizeCode;     ///< RAM size code at 0x0149.
+    u8 headerChecksum;  ///< Header checksum stored at 0x014D.
+    bool headerValid;   ///< Whether the header checksum matches.
+    bool globalValid;   ///< Whether the global checksum matches.
+    u8 reserved;
+};
+
+class RomIndex
+{
+private:
+    u8 *mapping = nullptr;                 ///< Read-only mapping of the index file.
+    size_t mappingSize = 0;                ///< Size of the mapping in bytes.
+    const RomIndexEntry *entries = nullptr; ///< Records inside the mapping.
+    u32 count = 0;                         ///< Number of records.
+
+    /**
+     * @brief Reads a ROM file and fills in its record.
+     *
+     * @param fileName Name of the ROM file.
+     * @param entry Record to fill; path, modifiedTime and fileSize are already set.
+     * @return true if the file is readable and large enough to hold a header.
+     */
+    static bool scanFile(std::string fileName, RomIndexEntry &entry);
+
+public:
+    /**
+     * @brief Destroy the RomIndex object and unmap the index file.
+     */
+    ~RomIndex();
+
+    /**
+     * @brief Scans a directory tree for ROMs and writes an index file, reusing the records of
+     * an existing index for files whose size and modification time are unchanged.
+     *
+     * @param directory Directory to scan for .gb, .gbc, .gz and .zip files.
+     * @param indexFile Name of the index file to write.
+     * @param scanned Set to the number of files that had to be read, if not nullptr.
+     * @return true if the index was written.
+     */
+    static bool build(std::string directory, std::string indexFile, int *scanned = nullptr);
+
+    /**
+     * @brief Maps an index file for queries.
+     *
+     * @param indexFile Name of the index file.
+     * @return true if the file is a valid index.
+     */
+    bool open(std::string indexFile);
+
+    /**
+     * @brief Get the number of ROMs in the index.
+     */
+    u32 size();
+
+    /**
+     * @brief Get a record by position, in path order.
+     *
+     * @param index Position below size().
+     */
+    const RomIndexEntry &getEntry(u32 index);
+
+    /**
+     * @brief Looks up a ROM by path.
+     *
+     * @param path Path relative to the indexed directory.
+     * @return The record, or nullptr if the path is not indexed.
+     */
+    const RomIndexEntry *find(std::string path);
+};
+
+#endif
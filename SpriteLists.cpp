@@ -0,0 +1,33 @@
+#include "SpriteLists.h"
+#include <algorithm>
+#include <cstring>
+
+void SpriteLists::build(const u8 *oam, int spriteHeight) {
+    height = spriteHeight;
+    std::memset(counts, 0, sizeof(counts));
+
+    for (int sprite = 0; sprite < SPRITE_COUNT; sprite++) {
+        const u8 *entry = oam + sprite * SPRITE_BYTES;
+        // OAM holds the screen position plus 16 for Y and plus 8 for X
+        int top = entry[0] - 16;
+        u8 x = entry[1];
+        int firstLine = std::max(top, 0);
+        int lastLine = std::min(top + spriteHeight, SPRITE_LINES);
+
+        for (int line = firstLine; line < lastLine; line++) {
+            // Later entries are dropped once a line has its 10, whatever their X
+            if (counts[line] == SPRITES_PER_LINE) {
+                continue;
+            }
+            // Insert after every sprite with a lower or equal X, so earlier entries win ties
+            u8 *list = sprites[line];
+            int position = counts[line];
+            while (position > 0 && oam[list[position - 1] * SPRITE_BYTES + 1] > x) {
+                list[position] = list[position - 1];
+                position--;
+            }
+            list[position] = sprite;
+            counts[line]++;
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/**
+ * @class SpriteLists
+ * @brief Sprites visible on each scanline
+ * This class buckets the 40 OAM entries into one list per visible scanline in a single pass over
+ * OAM, keeping the first 10 entries in OAM order that cover the line, as the DMG does. Each list is
+ * kept in drawing priority order: lower X first, and the earlier OAM entry first on equal X. The
+ * lists only need rebuilding when OAM or the sprite height changes, so rendering a scanline only
+ * touches the sprites on it.
+ */
+#ifndef SPRITELISTS_H
+#define SPRITELISTS_H
+
+#include "global.h"
+
+#define SPRITE_COUNT 40     ///< Entries in OAM.
+#define SPRITE_BYTES 4      ///< Bytes per OAM entry: Y, X, tile and attributes.
+#define SPRITES_PER_LINE 10 ///< Sprites the PPU fetches for one scanline.
+#define SPRITE_LINES 144    ///< Visible scanlines.
+
+class SpriteLists
+{
+private:
+    u8 sprites[SPRITE_LINES][SPRITES_PER_LINE] = {}; ///< OAM entry numbers for each line, highest priority first.
+    u8 counts[SPRITE_LINES] = {};                    ///< Number of sprites in each list.
+    int height = 0;                                  ///< Sprite height the lists were built for, 0 if never built.
+
+public:
+    /**
+     * @brief Rebuilds every list from OAM.
+     *
+     * @param oam The SPRITE_COUNT entries at 0xFE00.
+     * @param spriteHeight 8 or 16, from LCDC bit 2.
+     */
+    void build(const u8 *oam, int spriteHeight);
+
+    /**
+     * @brief Get the sprite height the lists were built for.
+     *
+     * @return int 8 or 16, or 0 before the first build.
+     */
+    int getHeight() const {
+        return height;
+    }
+
+    /**
+     * @brief Get the number of sprites on a scanline.
+     *
+     * @param line The scanline, 0-143.
+     * @return int 0 to SPRITES_PER_LINE.
+     */
+    int getCount(int line) const {
+        return counts[line];
+    }
+
+    /**
+     * @brief Get the sprites on a scanline.
+     *
+     * @param line The scanline, 0-143.
+     * @return const u8* getCount(line) OAM entry numbers, highest priority first.
+     */
+    const u8 *getSprites(int line) const {
+        return sprites[line];
+    }
+};
+
+#endif
@@ -0,0 +1,13 @@
+#include "TileCache.h"
+
+void TileCache::update(const u8 *vram, const std::bitset<TILE_COUNT> &dirty) {
+    if (dirty.none()) {
+        return;
+    }
+    for (int tile = 0; tile < TILE_COUNT; tile++) {
+        if (dirty[tile]) {
+            PixelKernels::decodeTile(vram + tile * TILE_BYTES, tiles[tile][0], false);
+            PixelKernels::decodeTile(vram + tile * TILE_BYTES, flippedTiles[tile][0], true);
+        }
+    }
+}
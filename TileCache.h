@@ -0,0 +1,45 @@
+/**
+ * @class TileCache
+ * @brief Pre-decoded VRAM tiles for the renderer
+ * This class keeps all 384 tiles of 0x8000-0x97FF expanded from their two bitplanes into 8x8
+ * arrays of 2-bit color indices, plus a horizontally flipped copy of each for sprites. Only the
+ * tiles the MMU reports as written since the last update are decoded again, so the renderer
+ * copies whole 8-pixel rows instead of extracting bits per pixel.
+ */
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <bitset>
+#include "global.h"
+#include "MMU.h"
+#include "PixelKernels.h"
+
+class TileCache
+{
+private:
+    u8 tiles[TILE_COUNT][TILE_SIZE][TILE_SIZE] = {};        ///< Color indices, indexed by tile, row and pixel.
+    u8 flippedTiles[TILE_COUNT][TILE_SIZE][TILE_SIZE] = {}; ///< The same rows mirrored horizontally.
+
+public:
+    /**
+     * @brief Decodes the tiles written since the last update.
+     *
+     * @param vram The 0x1800 bytes of tile data at 0x8000.
+     * @param dirty Tiles to decode, as returned by MMU::takeDirtyTiles.
+     */
+    void update(const u8 *vram, const std::bitset<TILE_COUNT> &dirty);
+
+    /**
+     * @brief Get the decoded pixels of one tile row.
+     *
+     * @param tile Tile index, 0-383 counting from 0x8000.
+     * @param row Row within the tile, 0-7.
+     * @param xFlip true for the horizontally flipped row.
+     * @return const u8* TILE_SIZE color indices, leftmost pixel first.
+     */
+    const u8 *getRow(int tile, int row, bool xFlip = false) const {
+        return xFlip ? flippedTiles[tile][row] : tiles[tile][row];
+    }
+};
+
+#endif
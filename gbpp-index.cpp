@@ -0,0 +1,30 @@
+/**
+ * @brief Builds or refreshes the ROM catalog index for a directory.
+ *
+ * Usage: gbpp-index <rom directory> [index file]
+ * The index file defaults to gbpp.index inside the ROM directory.
+ */
+#include <cstdio>
+#include <string>
+#include "RomIndex.h"
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <rom directory> [index file]\n", argv[0]);
+        return 1;
+    }
+    std::string directory = argv[1];
+    std::string indexFile = (argc > 2) ? argv[2] : directory + "/gbpp.index";
+
+    int scanned = 0;
+    if (!RomIndex::build(directory, indexFile, &scanned)) {
+        return 1;
+    }
+    RomIndex index;
+    if (!index.open(indexFile)) {
+        printf("Cannot open index file %s.\n", indexFile.c_str());
+        return 1;
+    }
+    printf("Indexed %u ROMs in %s, %d read from disk.\n", index.size(), indexFile.c_str(), scanned);
+    return 0;
+}
@@ -11,5 +11,6 @@ using u8 = std::uint8_t;
 using s8 = std::int8_t;
 using u16 = std::uint16_t;
 using u32 = std::uint32_t;
+using u64 = std::uint64_t;
 
 #endif
\ No newline at end of file
@@ -5,13 +5,962 @@
 #include "Cartridge.h"
 #include "Emulator.h"
 #include "Graphics.h"
+#include "Input.h"
+#include "RTC.h"
+#include "HugePages.h"
+#include "RomIndex.h"
+#include "TileCache.h"
+#include "Palette.h"
+#include "SpriteLists.h"
 
 #include <fstream>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <zlib.h>
 
 // Unit Testing
 #define CONFIG_CATCH_MAIN
 #include "catch_amalgamated.hpp"
 
+/**
+ * @brief Writes a blank ROM image with a valid header to disk for tests.
+ *
+ * @param fileName Name of the ROM file to create.
+ * @param cartridgeType Cartridge type byte stored at 0x0147.
+ * @param romSizeCode ROM size code stored at 0x0148.
+ * @param ramSizeCode RAM size code stored at 0x0149.
+ */
+static void writeTestROM(const char *fileName, u8 cartridgeType = 0x00, u8 romSizeCode = 0x00, u8 ramSizeCode = 0x00) {
+    std::vector<u8> rom(0x8000 << romSizeCode, 0x00);
+    // Tag the first byte of every 16 KB bank with its bank number
+    for (size_t bank = 0; bank < rom.size() / 0x4000; bank++) {
+        rom[bank * 0x4000] = (u8) bank;
+    }
+    std::memcpy(&rom[0x0134], "TESTROM", 7);
+    rom[0x0147] = cartridgeType;
+    rom[0x0148] = romSizeCode;
+    rom[0x0149] = ramSizeCode;
+
+    u8 checksum = 0;
+    for (u16 address = 0x0134; address <= 0x014C; address++) {
+        checksum = checksum - rom[address] - 1;
+    }
+    rom[0x014D] = checksum;
+
+    std::ofstream file(fileName, std::ios::binary);
+    file.write((const char *) rom.data(), rom.size());
+}
+
+TEST_CASE("MMU page tables route RAM and ROM accesses") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+
+    mmu.writeByte(0xC123, 0x42);
+    REQUIRE(mmu.readByte(0xC123) == 0x42);
+
+    // Echo RAM shares storage with WRAM in both directions
+    REQUIRE(mmu.readByte(0xE123) == 0x42);
+    mmu.writeByte(0xFDFF, 0x24);
+    REQUIRE(mmu.readByte(0xDDFF) == 0x24);
+
+    // ROM is read-only without an MBC
+    mmu.writeByte(0x0134, 0x00);
+    REQUIRE(mmu.readByte(0x0134) == 'T');
+
+    // The full address space is addressable, including IE at 0xFFFF
+    mmu.writeByte(0xFFFF, 0x1F);
+    REQUIRE(mmu.readByte(0xFFFF) == 0x1F);
+    mmu.writeWord(0xFF80, 0xBEEF);
+    REQUIRE(mmu.readWord(0xFF80) == 0xBEEF);
+}
+
+TEST_CASE("An MMU can be built from a ROM that failed to load") {
+    std::remove("test_missing.gb");
+    Cartridge cartridge("test_missing.gb");
+    REQUIRE(cartridge.getGameData() == nullptr);
+    MMU mmu(&cartridge);
+
+    // The ROM area has nothing behind it, and bank switches do not fault
+    mmu.writeByte(0x2000, 0x05);
+    mmu.readByte(0x0000);
+    mmu.readByte(0x4000);
+    mmu.writeByte(0xC000, 0x42);
+    REQUIRE(mmu.readByte(0xC000) == 0x42);
+}
+
+TEST_CASE("MBC1 and MBC5 switch banks by repointing pages") {
+    writeTestROM("test_mbc1.gb", 0x02, 0x02, 0x03);
+    Cartridge mbc1Cartridge("test_mbc1.gb");
+    MMU mbc1(&mbc1Cartridge);
+
+    REQUIRE(mbc1.readByte(0x4000) == 1);
+    mbc1.writeByte(0x2000, 0x03);
+    REQUIRE(mbc1.readByte(0x4000) == 3);
+    // Bank 0 selects bank 1
+    mbc1.writeByte(0x2000, 0x00);
+    REQUIRE(mbc1.readByte(0x4000) == 1);
+
+    // External RAM is only reachable once enabled, and each bank has its own storage
+    REQUIRE(mbc1.readByte(0xA000) == 0xFF);
+    mbc1.writeByte(0x0000, 0x0A);
+    mbc1.writeByte(0x6000, 0x01);
+    mbc1.writeByte(0xA000, 0x11);
+    mbc1.writeByte(0x4000, 0x01);
+    mbc1.writeByte(0xA000, 0x22);
+    mbc1.writeByte(0x4000, 0x00);
+    REQUIRE(mbc1.readByte(0xA000) == 0x11);
+
+    // Rewriting the selected bank or the RAM enable leaves the other windows mapped
+    mbc1.writeByte(0x2000, 0x03);
+    mbc1.writeByte(0x2000, 0x03);
+    REQUIRE(mbc1.readByte(0x4000) == 3);
+    mbc1.writeByte(0x0000, 0x0A);
+    REQUIRE(mbc1.readByte(0xA000) == 0x11);
+    mbc1.writeByte(0x0000, 0x00);
+    REQUIRE(mbc1.readByte(0xA000) == 0xFF);
+    REQUIRE(mbc1.readByte(0x4000) == 3);
+    mbc1.writeByte(0x0000, 0x0A);
+    REQUIRE(mbc1.readByte(0xA000) == 0x11);
+
+    writeTestROM("test_mbc5.gb", 0x19, 0x08);
+    Cartridge mbc5Cartridge("test_mbc5.gb");
+    MMU mbc5(&mbc5Cartridge);
+
+    mbc5.writeByte(0x2000, 0x05);
+    mbc5.writeByte(0x3000, 0x01);
+    REQUIRE(mbc5Cartridge.getGameData()[0x105 * 0x4000] == 0x05);
+    REQUIRE(mbc5.readByte(0x4000) == 0x05);
+    mbc5.writeByte(0x2000, 0x00);
+    mbc5.writeByte(0x3000, 0x00);
+    REQUIRE(mbc5.readByte(0x4000) == 0x00);
+}
+
+TEST_CASE("MBC2 decodes its registers by address bit 8") {
+    writeTestROM("test_mbc2.gb", 0x05, 0x02);
+    Cartridge cartridge("test_mbc2.gb");
+    MMU mmu(&cartridge);
+    REQUIRE(cartridge.getMapperType() == MBC_2);
+    REQUIRE(cartridge.getRAMSize() == MBC2_RAM_SIZE);
+
+    mmu.writeByte(0x2100, 0x03);
+    REQUIRE(mmu.readByte(0x4000) == 3);
+    // Bit 8 clear is the RAM enable register, not a bank switch
+    mmu.writeByte(0x2000, 0x0A);
+    REQUIRE(mmu.readByte(0x4000) == 3);
+
+    // Half-byte RAM repeats every 512 bytes
+    mmu.writeByte(0xA001, 0x5C);
+    REQUIRE(mmu.readByte(0xA001) == 0xFC);
+    REQUIRE(mmu.readByte(0xA201) == 0xFC);
+    REQUIRE(mmu.readByte(0xBE01) == 0xFC);
+}
+
+TEST_CASE("MBC3 clock is computed from elapsed cycles when latched") {
+    u8 block[RTC_SAVE_SIZE] = {};
+    u64 cycles = 0;
+    {
+        RTC rtc(block, RTC_EMULATED);
+        rtc.setCycleCounter(&cycles);
+        cycles = 3661ULL * CPU_CLOCK_SPEED / 4 + 5;
+        rtc.writeLatch(0x00);
+        rtc.writeLatch(0x01);
+        REQUIRE(rtc.readRegister(RTC_SECONDS) == 1);
+        REQUIRE(rtc.readRegister(RTC_SECONDS + 1) == 1);
+        REQUIRE(rtc.readRegister(RTC_SECONDS + 2) == 1);
+
+        // Latched registers hold until the next latch, and a halted clock stops
+        cycles += 10ULL * CPU_CLOCK_SPEED / 4;
+        REQUIRE(rtc.readRegister(RTC_SECONDS) == 1);
+        rtc.writeRegister(RTC_DAYS_HIGH, RTC_HALT);
+        cycles += 100ULL * CPU_CLOCK_SPEED / 4;
+        rtc.writeLatch(0x00);
+        rtc.writeLatch(0x01);
+        REQUIRE(rtc.readRegister(RTC_SECONDS) == 11);
+        REQUIRE(rtc.readRegister(RTC_DAYS_HIGH) == RTC_HALT);
+    }
+
+    // The clock is written back to its save block
+    RTC restored(block, RTC_EMULATED);
+    restored.writeLatch(0x00);
+    restored.writeLatch(0x01);
+    REQUIRE(restored.readRegister(RTC_SECONDS) == 11);
+
+    writeTestROM("test_rtc.gb", 0x10, 0x01, 0x03);
+    {
+        Cartridge cartridge("test_rtc.gb");
+        MMU mmu(&cartridge);
+        mmu.writeByte(0x0000, 0x0A);
+        mmu.writeByte(0x4000, RTC_DAYS_HIGH);
+        mmu.writeByte(0xA000, RTC_HALT);
+        mmu.writeByte(0x4000, RTC_SECONDS);
+        mmu.writeByte(0xA000, 42);
+        mmu.writeByte(0x6000, 0x00);
+        mmu.writeByte(0x6000, 0x01);
+        REQUIRE(mmu.readByte(0xA000) == 42);
+        mmu.writeByte(0x4000, 0x00);
+        mmu.writeByte(0xA000, 0x11);
+        REQUIRE(mmu.readByte(0xA000) == 0x11);
+    }
+    REQUIRE(std::filesystem::file_size("test_rtc.sav") == 0x8000 + RTC_SAVE_SIZE);
+    std::remove("test_rtc.sav");
+}
+
+TEST_CASE("Cartridges loading the same file share one ROM image") {
+    writeTestROM("test_shared.gb", 0x19, 0x07);
+    {
+        Cartridge first("test_shared.gb");
+        Cartridge second("test_shared.gb");
+        REQUIRE(first.getGameData() == second.getGameData());
+
+        MMU firstMMU(&first);
+        MMU secondMMU(&second);
+        firstMMU.writeByte(0x2000, 0x07);
+        REQUIRE(firstMMU.readByte(0x4000) == 0x07);
+        REQUIRE(secondMMU.readByte(0x4000) == 0x01);
+    }
+
+    // The image is dropped with its last cartridge, so a rewritten file is loaded afresh
+    writeTestROM("test_shared.gb", 0x19, 0x06);
+    Cartridge reloaded("test_shared.gb");
+    REQUIRE(reloaded.getROMSize() == 0x200000);
+
+    // A 2 MB ROM is still mapped from the file rather than copied
+    std::ifstream maps("/proc/self/maps");
+    std::string mapping;
+    bool fileMapped = false;
+    uintptr_t address = (uintptr_t) reloaded.getGameData();
+    while (std::getline(maps, mapping)) {
+        unsigned long start, end;
+        if (sscanf(mapping.c_str(), "%lx-%lx", &start, &end) == 2 && address >= start && address < end) {
+            fileMapped = mapping.find("test_shared.gb") != std::string::npos;
+        }
+    }
+    REQUIRE(fileMapped);
+
+    // Concurrent loads of one file wait for a single image while other files load alongside
+    writeTestROM("test_other.gb", 0x19, 0x06);
+    std::vector<std::shared_ptr<const ROMImage>> loaded(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < loaded.size(); i++) {
+        threads.emplace_back([&loaded, i] {
+            loaded[i] = ROMImage::load((i % 2) ? "test_shared.gb" : "test_other.gb");
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    for (size_t i = 0; i < loaded.size(); i++) {
+        REQUIRE(loaded[i] != nullptr);
+        REQUIRE(loaded[i] == loaded[i % 2]);
+    }
+    REQUIRE(loaded[1]->getData() == reloaded.getGameData());
+    REQUIRE(loaded[0] != loaded[1]);
+    loaded.clear();
+    std::remove("test_other.gb");
+}
+
+/**
+ * @brief Packs a file into a zip archive without compression, after an unrelated entry.
+ *
+ * @param zipName Name of the archive to create.
+ * @param fileName File to pack.
+ */
+static void writeStoredZip(const char *zipName, const char *fileName) {
+    std::ifstream input(fileName, std::ios::binary);
+    std::vector<u8> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    std::vector<u8> zip;
+    auto put = [&](u32 value, int size) {
+        for (int i = 0; i < size; i++) {
+            zip.push_back((value >> (8 * i)) & 0xFF);
+        }
+    };
+    auto putName = [&](const std::string &name) {
+        zip.insert(zip.end(), name.begin(), name.end());
+    };
+
+    std::vector<std::pair<std::string, std::vector<u8>>> entries = {{"readme.txt", {'h', 'i'}}, {"game.gb", data}};
+    std::vector<u32> offsets;
+    for (auto &entry : entries) {
+        offsets.push_back(zip.size());
+        put(0x04034B50, 4); put(10, 2); put(0, 2); put(0, 2); put(0, 4);
+        put(crc32(0, entry.second.data(), entry.second.size()), 4);
+        put(entry.second.size(), 4); put(entry.second.size(), 4);
+        put(entry.first.size(), 2); put(0, 2);
+        putName(entry.first);
+        zip.insert(zip.end(), entry.second.begin(), entry.second.end());
+    }
+    u32 directory = zip.size();
+    for (size_t i = 0; i < entries.size(); i++) {
+        put(0x02014B50, 4); put(20, 2); put(10, 2); put(0, 2); put(0, 2); put(0, 4);
+        put(crc32(0, entries[i].second.data(), entries[i].second.size()), 4);
+        put(entries[i].second.size(), 4); put(entries[i].second.size(), 4);
+        put(entries[i].first.size(), 2); put(0, 2); put(0, 2); put(0, 2); put(0, 2); put(0, 4);
+        put(offsets[i], 4);
+        putName(entries[i].first);
+    }
+    u32 directorySize = zip.size() - directory;
+    put(0x06054B50, 4); put(0, 2); put(0, 2); put(entries.size(), 2); put(entries.size(), 2);
+    put(directorySize, 4); put(directory, 4); put(0, 2);
+    std::ofstream(zipName, std::ios::binary).write((const char *) zip.data(), zip.size());
+}
+
+TEST_CASE("Compressed ROMs load straight into the ROM image") {
+    writeTestROM("test_packed.gb", 0x19, 0x02);
+    std::ifstream input("test_packed.gb", std::ios::binary);
+    std::vector<u8> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+    gzFile gz = gzopen("test_packed.gb.gz", "wb");
+    gzwrite(gz, rom.data(), rom.size());
+    gzclose(gz);
+    Cartridge gzipped("test_packed.gb.gz");
+    REQUIRE(gzipped.getROMSize() == (long) rom.size());
+    REQUIRE(std::memcmp(gzipped.getGameData(), rom.data(), rom.size()) == 0);
+
+    writeStoredZip("test_packed.zip", "test_packed.gb");
+    Cartridge zipped("test_packed.zip");
+    REQUIRE(zipped.getROMSize() == (long) rom.size());
+    REQUIRE(std::string(zipped.getCartridgeHeader().title) == "TESTROM");
+    MMU mmu(&zipped);
+    mmu.writeByte(0x2000, 0x05);
+    REQUIRE(mmu.readByte(0x4000) == 0x05);
+
+    // A corrupt header is rejected before the rest is inflated
+    rom[0x0134] ^= 0xFF;
+    gz = gzopen("test_corrupt.gb.gz", "wb");
+    gzwrite(gz, rom.data(), rom.size());
+    gzclose(gz);
+    REQUIRE(ROMImage::load("test_corrupt.gb.gz") == nullptr);
+
+    // Sizes in the file are not trusted: an oversized or short gzip size is rejected
+    auto patchFile = [](const char *source, const char *target, long offset, u32 value, int size) {
+        std::ifstream input(source, std::ios::binary);
+        std::vector<u8> bytes((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        long position = offset < 0 ? bytes.size() + offset : offset;
+        for (int i = 0; i < size; i++) {
+            bytes[position + i] = (value >> (8 * i)) & 0xFF;
+        }
+        std::ofstream(target, std::ios::binary).write((const char *) bytes.data(), bytes.size());
+    };
+    patchFile("test_packed.gb.gz", "test_huge.gb.gz", -4, 0xFFFFFF00, 4);
+    REQUIRE(ROMImage::load("test_huge.gb.gz") == nullptr);
+    patchFile("test_packed.gb.gz", "test_short.gb.gz", -4, 0x8000, 4);
+    REQUIRE(ROMImage::load("test_short.gb.gz") == nullptr);
+
+    // A zip whose data no longer matches the directory CRC is rejected, and so is zip64
+    std::ifstream archive("test_packed.zip", std::ios::binary);
+    std::vector<u8> zipBytes((std::istreambuf_iterator<char>(archive)), std::istreambuf_iterator<char>());
+    long romOffset = 0;
+    while (std::memcmp(&zipBytes[romOffset], "game.gb", 7) != 0) {
+        romOffset++;
+    }
+    romOffset += 7;
+    patchFile("test_packed.zip", "test_bad_crc.zip", romOffset + 0x4000, 0x07, 1);
+    REQUIRE(ROMImage::load("test_bad_crc.zip") == nullptr);
+    patchFile("test_packed.zip", "test_zip64.zip", -6, 0xFFFFFFFF, 4);
+    REQUIRE(ROMImage::load("test_zip64.zip") == nullptr);
+
+    for (const char *name : {"test_packed.gb.gz", "test_packed.zip", "test_corrupt.gb.gz", "test_huge.gb.gz",
+                             "test_short.gb.gz", "test_bad_crc.zip", "test_zip64.zip"}) {
+        std::remove(name);
+    }
+}
+
+TEST_CASE("ROM validation checks the checksums logo and size") {
+    writeTestROM("test_valid.gb", 0x19, 0x03);
+    std::vector<u8> rom;
+    {
+        std::ifstream input("test_valid.gb", std::ios::binary);
+        rom.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    }
+    std::memcpy(&rom[0x0104], Cartridge::logo, LOGO_SIZE);
+    rom[0x014D] = Cartridge::getHeaderChecksum(rom.data());
+
+    // The vectorised sum agrees with a byte loop, including a tail shorter than one block
+    rom[rom.size() - 1] = 0xAB;
+    for (long size : {(long) rom.size(), (long) rom.size() - 37}) {
+        u16 expected = 0;
+        for (long i = 0; i < size; i++) {
+            if (i != 0x014E && i != 0x014F) expected += rom[i];
+        }
+        REQUIRE(Cartridge::getGlobalChecksum(rom.data(), size) == expected);
+    }
+    u16 global = Cartridge::getGlobalChecksum(rom.data(), rom.size());
+    rom[0x014E] = global >> 8;
+    rom[0x014F] = global & 0xFF;
+    std::ofstream("test_valid.gb", std::ios::binary).write((const char *) rom.data(), rom.size());
+
+    Cartridge valid("test_valid.gb");
+    ROMValidation result = valid.getValidation();
+    REQUIRE(result.headerChecksum);
+    REQUIRE(result.globalChecksum);
+    REQUIRE(result.logo);
+    REQUIRE(result.size);
+
+    // A flipped byte deep in the ROM only shows up in the global checksum
+    rom[0x12345] ^= 0x01;
+    result = Cartridge::validate(rom.data(), rom.size());
+    REQUIRE(result.headerChecksum);
+    REQUIRE_FALSE(result.globalChecksum);
+    REQUIRE_FALSE(Cartridge::validate(rom.data(), rom.size() - 0x4000).size);
+
+    writeTestROM("test_rom.gb");
+    Cartridge unlicensed("test_rom.gb");
+    REQUIRE_FALSE(unlicensed.getValidation().logo);
+}
+
+TEST_CASE("Battery-backed RAM persists through the save file") {
+    std::remove("test_battery.sav");
+    writeTestROM("test_battery.gb", 0x03, 0x00, 0x02);
+    {
+        Cartridge cartridge("test_battery.gb");
+        MMU mmu(&cartridge);
+        mmu.writeByte(0x0000, 0x0A);
+        REQUIRE(mmu.readByte(0xA010) == 0xFF);
+        mmu.writeByte(0xA010, 0x5A);
+    }
+    {
+        Cartridge cartridge("test_battery.gb");
+        MMU mmu(&cartridge);
+        mmu.writeByte(0x0000, 0x0A);
+        REQUIRE(mmu.readByte(0xA010) == 0x5A);
+    }
+    REQUIRE(std::filesystem::file_size("test_battery.sav") == 0x2000);
+}
+
+TEST_CASE("I/O register writes dispatch to their handlers") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+    CPU cpu(&mmu);
+    Input input(mmu);
+
+    // DIV resets on any write
+    cpu.updateTimer(64 * 3);
+    REQUIRE(mmu.readByte(DIV_ADDR) == 3);
+    mmu.writeByte(DIV_ADDR, 0x42);
+    REQUIRE(mmu.readByte(DIV_ADDR) == 0);
+
+    // NR52 reads back the DMG power-on value, with channel 1 still on
+    REQUIRE(mmu.readByte(0xFF26) == 0xF1);
+
+    // Unused IF bits read as 1
+    mmu.writeByte(IF_ADDR, 0x00);
+    REQUIRE(mmu.readByte(IF_ADDR) == 0xE0);
+
+    // JOYP shows the selected key group and a press raises the joypad interrupt
+    input.pressKey('1');
+    REQUIRE(mmu.readByte(IF_ADDR) == 0xF0);
+    mmu.writeByte(JOYP_ADDR, 0x10);
+    REQUIRE(mmu.readByte(JOYP_ADDR) == 0xDE);
+    mmu.writeByte(JOYP_ADDR, 0x20);
+    REQUIRE(mmu.readByte(JOYP_ADDR) == 0xEF);
+}
+
+TEST_CASE("OAM DMA copies a page and locks the bus for 160 cycles") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+
+    for (int i = 0; i < OAM_SIZE; i++) {
+        mmu.writeByte(0xC100 + i, i);
+    }
+    mmu.writeByte(0xFF80, 0x12);
+    HotState *hot = mmu.getHotState();
+    hot->cycles = 1000;
+    hot->nextEvent = 5000;
+    mmu.writeByte(DMA_ADDR, 0xC1);
+
+    // Only HRAM and I/O respond during the transfer, whose end is the main loop's next event
+    REQUIRE(mmu.isDMAActive());
+    REQUIRE(hot->nextEvent == 1000 + DMA_CYCLES);
+    REQUIRE(mmu.getDMAEnd() == 1000 + DMA_CYCLES);
+    REQUIRE(mmu.readByte(0xC100) == 0xFF);
+    REQUIRE(mmu.readByte(0xFF80) == 0x12);
+    hot->cycles += DMA_CYCLES - 1;
+    mmu.updateDMA();
+    REQUIRE(mmu.isDMAActive());
+    hot->cycles += 1;
+    mmu.updateDMA();
+    REQUIRE(!mmu.isDMAActive());
+
+    REQUIRE(mmu.readByte(0xC100) == 0x00);
+    REQUIRE(mmu.readByte(0xFE00) == 0x00);
+    REQUIRE(mmu.readByte(0xFE9F) == 0x9F);
+}
+
+TEST_CASE("Sprite lists follow the per-line limit and priority order") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+    REQUIRE(mmu.takeOAMDirty());
+
+    // Twelve sprites on lines 0-7, placed right to left, and one 8x16 sprite at the top edge
+    for (int sprite = 0; sprite < 12; sprite++) {
+        mmu.writeByte(0xFE00 + sprite * SPRITE_BYTES, 16);
+        mmu.writeByte(0xFE00 + sprite * SPRITE_BYTES + 1, 100 - sprite * 4);
+    }
+    mmu.writeByte(0xFE00 + 3 * SPRITE_BYTES + 1, 100 - 4 * 4);
+    mmu.writeByte(0xFE00 + 12 * SPRITE_BYTES, 4);
+    mmu.writeByte(0xFE00 + 12 * SPRITE_BYTES + 1, 50);
+    REQUIRE(mmu.takeOAMDirty());
+    REQUIRE_FALSE(mmu.takeOAMDirty());
+
+    SpriteLists lists;
+    lists.build(mmu.getOAM(), 8);
+    // Only the first ten entries in OAM order are kept, lowest X first, the earlier entry on equal X
+    REQUIRE(lists.getCount(0) == SPRITES_PER_LINE);
+    const u8 expected[SPRITES_PER_LINE] = {9, 8, 7, 6, 5, 3, 4, 2, 1, 0};
+    REQUIRE(std::memcmp(lists.getSprites(0), expected, SPRITES_PER_LINE) == 0);
+    REQUIRE(lists.getCount(8) == 0);
+
+    // Entry 12 starts 12 lines above the screen, so only a tall sprite reaches lines 0-3,
+    // and only once earlier entries leave room for it
+    lists.build(mmu.getOAM(), 16);
+    REQUIRE(lists.getCount(15) == SPRITES_PER_LINE);
+    REQUIRE(lists.getCount(16) == 0);
+    REQUIRE(lists.getSprites(3)[0] == 9);
+    for (int sprite = 0; sprite < 3; sprite++) {
+        mmu.writeByte(0xFE00 + sprite * SPRITE_BYTES, 0);
+    }
+    lists.build(mmu.getOAM(), 16);
+    REQUIRE(lists.getCount(3) == SPRITES_PER_LINE);
+    REQUIRE(lists.getCount(4) == SPRITES_PER_LINE - 1);
+    REQUIRE(lists.getSprites(3)[0] == 12);
+
+    // A completed DMA transfer marks OAM as changed
+    mmu.takeOAMDirty();
+    mmu.writeByte(DMA_ADDR, 0xC1);
+    REQUIRE_FALSE(mmu.takeOAMDirty());
+    mmu.getHotState()->cycles += DMA_CYCLES;
+    mmu.updateDMA();
+    REQUIRE(mmu.takeOAMDirty());
+}
+
+TEST_CASE("Watchpoints report accesses to the watched address only") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+
+    std::vector<WatchHit> hits;
+    WatchHandler record = [](void *context, const WatchHit &hit) {
+        ((std::vector<WatchHit> *) context)->push_back(hit);
+    };
+    mmu.writeByte(0xC010, 0x01);
+    mmu.addWatchpoint(0xC010, WATCH_WRITE, record, &hits);
+    mmu.addWatchpoint(0x0150, WATCH_EXECUTE, record, &hits);
+
+    mmu.writeByte(0xC011, 0x07);
+    mmu.writeByte(0xC010, 0x02);
+    REQUIRE(mmu.readByte(0xC010) == 0x02);
+    mmu.readByte(0x0150);
+    mmu.fetchByte(0x0150);
+
+    REQUIRE(hits.size() == 2);
+    REQUIRE(hits[0].type == WATCH_WRITE);
+    REQUIRE(hits[0].previous == 0x01);
+    REQUIRE(hits[0].value == 0x02);
+    REQUIRE(hits[1].type == WATCH_EXECUTE);
+    REQUIRE(hits[1].location == 0x0150);
+
+    // Echo RAM writes reach the same WRAM byte
+    mmu.writeByte(0xE011, 0x08);
+    mmu.writeByte(0xE010, 0x04);
+    REQUIRE(hits.size() == 3);
+    REQUIRE(hits[2].location == 0xE010);
+    REQUIRE(hits[2].previous == 0x02);
+    REQUIRE(hits[2].value == 0x04);
+
+    mmu.removeWatchpoint(0xE010, WATCH_WRITE);
+    mmu.writeByte(0xC010, 0x03);
+    mmu.writeByte(0xE010, 0x05);
+    REQUIRE(hits.size() == 3);
+    REQUIRE(mmu.readByte(0xC010) == 0x05);
+}
+
+TEST_CASE("VRAM writes mark tiles and map rows dirty") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+
+    REQUIRE(mmu.takeDirtyTiles().all());
+    REQUIRE(mmu.takeDirtyMapRows().all());
+    REQUIRE(mmu.takeDirtyTiles().none());
+
+    mmu.writeByte(0x8010, 0xFF);
+    mmu.writeByte(0x97FF, 0xFF);
+    mmu.writeByte(0x9C20, 0x01);
+    // Writing the stored value changes nothing
+    mmu.writeByte(0x8020, 0x00);
+
+    std::bitset<TILE_COUNT> tiles = mmu.takeDirtyTiles();
+    REQUIRE(tiles.count() == 2);
+    REQUIRE(tiles[1]);
+    REQUIRE(tiles[383]);
+    std::bitset<MAP_ROW_COUNT> rows = mmu.takeDirtyMapRows();
+    REQUIRE(rows.count() == 1);
+    REQUIRE(rows[33]);
+    REQUIRE(mmu.readByte(0x9C20) == 0x01);
+}
+
+TEST_CASE("Tile cache decodes only the tiles written") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+    TileCache cache;
+    cache.update(mmu.getVRAM(), mmu.takeDirtyTiles());
+
+    // Row 3 of tile 2: low plane 0b10100000, high plane 0b11000001
+    mmu.writeByte(0x8026, 0xA0);
+    mmu.writeByte(0x8027, 0xC1);
+    cache.update(mmu.getVRAM(), mmu.takeDirtyTiles());
+    const u8 expected[TILE_SIZE] = {3, 2, 1, 0, 0, 0, 0, 2};
+    REQUIRE(std::memcmp(cache.getRow(2, 3), expected, TILE_SIZE) == 0);
+    for (int pixel = 0; pixel < TILE_SIZE; pixel++) {
+        REQUIRE(cache.getRow(2, 3, true)[pixel] == expected[TILE_SIZE - 1 - pixel]);
+    }
+
+    // Tiles whose bits were not taken are left as they were decoded
+    mmu.writeByte(0x9000, 0xFF);
+    std::bitset<TILE_COUNT> dirty = mmu.takeDirtyTiles();
+    REQUIRE(dirty[256]);
+    dirty.reset(256);
+    cache.update(mmu.getVRAM(), dirty);
+    REQUIRE(cache.getRow(256, 0)[0] == 0);
+}
+
+TEST_CASE("Pixel kernels match a bit-by-bit decode") {
+    u8 data[TILE_BYTES];
+    for (int i = 0; i < TILE_BYTES; i++) {
+        data[i] = (u8) (i * 37 + 11);
+    }
+    u8 tile[TILE_SIZE * TILE_SIZE];
+    u8 flipped[TILE_SIZE * TILE_SIZE];
+    PixelKernels::decodeTile(data, tile, false);
+    PixelKernels::decodeTile(data, flipped, true);
+    for (int row = 0; row < TILE_SIZE; row++) {
+        for (int pixel = 0; pixel < TILE_SIZE; pixel++) {
+            int bit = 7 - pixel;
+            u8 color = (((data[row * 2 + 1] >> bit) & 1) << 1) | ((data[row * 2] >> bit) & 1);
+            REQUIRE(tile[row * TILE_SIZE + pixel] == color);
+            REQUIRE(flipped[row * TILE_SIZE + TILE_SIZE - 1 - pixel] == color);
+        }
+    }
+
+    // Every length, so both the vector loop and the scalar tail are covered
+    const u32 palette[PALETTE_SIZE] = {0x11223344, 0x55667788, 0x99AABBCC, 0xDDEEFF00};
+    u8 colors[40];
+    for (int i = 0; i < 40; i++) {
+        colors[i] = (i * 7) & 3;
+    }
+    for (int count = 0; count <= 40; count++) {
+        u32 pixels[41] = {};
+        PixelKernels::mapColors(colors, count, palette, pixels);
+        for (int i = 0; i < count; i++) {
+            REQUIRE(pixels[i] == palette[colors[i]]);
+        }
+        REQUIRE(pixels[count] == 0);
+    }
+}
+
+TEST_CASE("Palettes map color indices through the register") {
+    Palette rgba(PIXEL_RGBA8888);
+    Palette rgb565(PIXEL_RGB565);
+    Palette gray(PIXEL_GRAY8);
+
+    // 0xE4 is the identity: index 0 white through index 3 black
+    REQUIRE(rgba.getColors()[0] == 0xFFFFFFFF);
+    REQUIRE(rgba.getColors()[3] == 0xFF000000);
+
+    // Index 0 black, 1 white, 2 dark grey, 3 light grey
+    for (Palette *palette : {&rgba, &rgb565, &gray}) {
+        palette->update(0x63);
+    }
+    for (int format : {PIXEL_RGBA8888, PIXEL_RGB565, PIXEL_GRAY8}) {
+        const u32 *colors = (format == PIXEL_RGBA8888) ? rgba.getColors() : (format == PIXEL_RGB565) ? rgb565.getColors() : gray.getColors();
+        REQUIRE(colors[0] == Palette::encode(format, 3));
+        REQUIRE(colors[1] == Palette::encode(format, 0));
+        REQUIRE(colors[2] == Palette::encode(format, 2));
+        REQUIRE(colors[3] == Palette::encode(format, 1));
+    }
+    REQUIRE(rgb565.getColors()[1] == 0xFFFF);
+    REQUIRE(gray.getColors()[2] == 0x77);
+
+    // Narrow formats go through the generic mapping
+    const u8 indices[5] = {0, 1, 2, 3, 1};
+    u16 pixels[5];
+    PixelKernels::mapColors(indices, 5, rgb565.getColors(), pixels);
+    REQUIRE(pixels[0] == 0x0000);
+    REQUIRE(pixels[4] == 0xFFFF);
+}
+
+TEST_CASE("Heatmap counts accesses per page bank and register") {
+    writeTestROM("test_mbc1.gb", 0x02, 0x05, 0x03);
+    Cartridge cartridge("test_mbc1.gb");
+    MMU mmu(&cartridge);
+    mmu.enableHeatmap(true);
+
+    mmu.readByte(0x4000);
+    mmu.writeByte(0x2000, 0x02);
+    mmu.readByte(0x4001);
+    mmu.readByte(0x4002);
+    mmu.writeByte(0xC000, 0x01);
+    mmu.readByte(0xFF44);
+    mmu.getHeatmap()->endFrame();
+
+    REQUIRE(mmu.getHeatmap()->exportCSV("test_heatmap.csv"));
+    std::ifstream file("test_heatmap.csv");
+    std::string csv((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    REQUIRE(csv.find("rom,0,0x2000,0,1\n") != std::string::npos);
+    REQUIRE(csv.find("rom,1,0x4000,1,0\n") != std::string::npos);
+    REQUIRE(csv.find("rom,2,0x4000,2,0\n") != std::string::npos);
+    REQUIRE(csv.find("wram,0,0xC000,0,1\n") != std::string::npos);
+    REQUIRE(csv.find("io,0,0xFF44,1,0\n") != std::string::npos);
+
+    // A bank switched into 0x0000 is reported at 0x0000, and disabled RAM has no bank
+    mmu.writeByte(0x6000, 0x01);
+    mmu.writeByte(0x4000, 0x01);
+    mmu.getHeatmap()->reset();
+    mmu.readByte(0x0000);
+    mmu.readByte(0xA000);
+    mmu.writeByte(0x0000, 0x0A);
+    mmu.readByte(0xA000);
+    REQUIRE(mmu.getHeatmap()->exportCSV("test_heatmap.csv"));
+    file = std::ifstream("test_heatmap.csv");
+    csv.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    REQUIRE(csv.find("rom,32,0x0000,1,1\n") != std::string::npos);
+    REQUIRE(csv.find("rom,32,0x4000") == std::string::npos);
+    REQUIRE(csv.find("sram,-1,0xA000,1,0\n") != std::string::npos);
+    REQUIRE(csv.find("sram,1,0xA000,1,0\n") != std::string::npos);
+
+    // Counting off restores the fast path
+    mmu.enableHeatmap(false);
+    REQUIRE(mmu.getHeatmap() == nullptr);
+    REQUIRE(mmu.readByte(0x4000) == 34);
+}
+
+TEST_CASE("Boot ROM overlays the cartridge until 0xFF50 is written") {
+    writeTestROM("test_rom.gb");
+    std::vector<u8> boot(BOOT_ROM_SIZE, 0x31);
+    std::ofstream("test_boot.bin", std::ios::binary).write((const char *) boot.data(), boot.size());
+
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+    REQUIRE(mmu.loadBootROM("test_boot.bin"));
+    REQUIRE(mmu.readByte(0x0000) == 0x31);
+    REQUIRE(mmu.readByte(0x00FF) == 0x31);
+    REQUIRE(mmu.readByte(0x0100) == 0x00);
+
+    mmu.writeByte(BOOT_ADDR, 0x01);
+    REQUIRE(!mmu.isBootROMMapped());
+    REQUIRE(mmu.readByte(0x0000) == 0x00);
+}
+
+TEST_CASE("CPU registers and the I/O page share one hot state block") {
+    writeTestROM("test_rom.gb");
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+    CPU cpu(&mmu);
+    HotState *hot = mmu.getHotState();
+    REQUIRE((uintptr_t) hot % CACHE_LINE_SIZE == 0);
+    REQUIRE(hot->PC.getWord() == 0x0100);
+
+    cpu.setSP(0xC100);
+    mmu.writeByte(IE_ADDR, 0x05);
+    mmu.writeByte(0xFF80, 0x42);
+    REQUIRE(hot->SP.getWord() == 0xC100);
+    REQUIRE(hot->io[0xFF] == 0x05);
+    REQUIRE(hot->io[0x80] == 0x42);
+
+    // Restoring a copy of the block restores registers and HRAM together
+    HotState saved = *hot;
+    cpu.setSP(0xD000);
+    mmu.writeByte(0xFF80, 0x00);
+    *hot = saved;
+    REQUIRE(cpu.getSP() == 0xC100);
+    REQUIRE(mmu.readByte(0xFF80) == 0x42);
+}
+
+TEST_CASE("Snapshots copy only pages written since the last one") {
+    writeTestROM("test_rom.gb", 0x1A, 0x01, 0x03);
+    Cartridge cartridge("test_rom.gb");
+    MMU mmu(&cartridge);
+    mmu.writeByte(0x0000, 0x0A);
+    mmu.writeByte(0xC000, 0x11);
+    mmu.writeByte(0xA000, 0x22);
+
+    MemorySnapshot first;
+    mmu.takeSnapshot(first);
+    REQUIRE(mmu.getDirtyPageCount() == 0);
+
+    mmu.writeByte(0xC000, 0x33);
+    mmu.writeByte(0xE001, 0x44);
+    mmu.writeByte(0xA000, 0x55);
+    mmu.writeByte(0x2000, 0x02);
+    REQUIRE(mmu.getDirtyPageCount() == 2);
+    REQUIRE(mmu.readByte(0xC001) == 0x44);
+
+    MemorySnapshot second;
+    mmu.takeSnapshot(second);
+    REQUIRE(second.pages[0xC0] != first.pages[0xC0]);
+    REQUIRE(second.pages[0xD0] == first.pages[0xD0]);
+
+    mmu.restoreSnapshot(first);
+    REQUIRE(mmu.readByte(0xC000) == 0x11);
+    REQUIRE(mmu.readByte(0xC001) == 0x00);
+    REQUIRE(mmu.readByte(0xA000) == 0x22);
+    REQUIRE(mmu.readByte(0x4000) == 0x01);
+
+    mmu.restoreSnapshot(second);
+    REQUIRE(mmu.readByte(0xE000) == 0x33);
+    REQUIRE(mmu.readByte(0x4000) == 0x02);
+}
+
+TEST_CASE("Snapshots restore the cartridge clock and cycle count") {
+    // An emulated clock replays the same values from a snapshot
+    u8 block[RTC_SAVE_SIZE] = {};
+    u64 cycles = 0;
+    RTC rtc(block, RTC_EMULATED);
+    rtc.setCycleCounter(&cycles);
+    cycles = 5ULL * CPU_CLOCK_SPEED / 4;
+    rtc.writeLatch(0x00);
+    rtc.writeLatch(0x01);
+    REQUIRE(rtc.readRegister(RTC_SECONDS) == 5);
+    RTCState clock = rtc.saveState();
+    u64 snapshotCycles = cycles;
+
+    cycles += 20ULL * CPU_CLOCK_SPEED / 4;
+    rtc.writeRegister(RTC_SECONDS + 1, 7);
+    rtc.writeLatch(0x00);
+    rtc.writeLatch(0x01);
+    REQUIRE(rtc.readRegister(RTC_SECONDS) == 25);
+
+    cycles = snapshotCycles;
+    rtc.loadState(clock);
+    REQUIRE(rtc.readRegister(RTC_SECONDS) == 5);
+    cycles += 3ULL * CPU_CLOCK_SPEED / 4;
+    rtc.writeLatch(0x00);
+    rtc.writeLatch(0x01);
+    REQUIRE(rtc.readRegister(RTC_SECONDS) == 8);
+    REQUIRE(rtc.readRegister(RTC_SECONDS + 1) == 0);
+
+    // Cartridge and CPU snapshots carry the clock and the cycle count
+    writeTestROM("test_rtc.gb", 0x10, 0x01, 0x03);
+    {
+        Cartridge cartridge("test_rtc.gb");
+        MMU mmu(&cartridge);
+        CPU cpu(&mmu);
+        mmu.writeByte(0x0000, 0x0A);
+        mmu.writeByte(0x4000, RTC_DAYS_HIGH);
+        mmu.writeByte(0xA000, RTC_HALT);
+        mmu.writeByte(0x4000, RTC_SECONDS);
+        mmu.writeByte(0xA000, 30);
+        mmu.getHotState()->cycles = 1234;
+        mmu.getHotState()->nextEvent = 5678;
+        mmu.writeByte(0x6000, 0x00);
+        mmu.writeByte(0x6000, 0x01);
+        CPUState cpuState = cpu.saveState();
+        MemorySnapshot snapshot;
+        mmu.takeSnapshot(snapshot);
+
+        mmu.writeByte(0xA000, 50);
+        mmu.writeByte(0x6000, 0x00);
+        mmu.writeByte(0x6000, 0x01);
+        REQUIRE(mmu.readByte(0xA000) == 50);
+        mmu.getHotState()->cycles = 99999;
+
+        cpu.loadState(cpuState);
+        mmu.restoreSnapshot(snapshot);
+        REQUIRE(mmu.getHotState()->cycles == 1234);
+        REQUIRE(mmu.getHotState()->nextEvent == 5678);
+        REQUIRE(mmu.readByte(0xA000) == 30);
+        mmu.writeByte(0x6000, 0x00);
+        mmu.writeByte(0x6000, 0x01);
+        REQUIRE(mmu.readByte(0xA000) == 30);
+    }
+    std::remove("test_rtc.sav");
+}
+
+TEST_CASE("Huge page buffers are aligned and snapshot pages reuse arena blocks") {
+    PageArena &arena = PageArena::getInstance();
+    void *block = arena.allocate(sizeof(PageData));
+    arena.deallocate(block, sizeof(PageData));
+    REQUIRE(arena.allocate(sizeof(PageData)) == block);
+    arena.deallocate(block, sizeof(PageData));
+
+    // Snapshot pages, control block included, come out of the freed block
+    std::shared_ptr<PageData> page = std::allocate_shared<PageData>(ArenaAllocator<PageData>());
+    REQUIRE((u8 *) page.get() >= (u8 *) block);
+    REQUIRE((u8 *) page.get() + sizeof(PageData) <= (u8 *) block + ARENA_BLOCK_SIZE);
+    page.reset();
+
+    u8 *buffer = HugePages::allocate(2 * HUGE_PAGE_SIZE + 1);
+    REQUIRE(buffer != nullptr);
+    REQUIRE((uintptr_t) buffer % HUGE_PAGE_SIZE == 0);
+    std::memset(buffer, 0xFF, 2 * HUGE_PAGE_SIZE + 1);
+
+    // The kernel only accepts the advice when transparent huge pages are enabled
+    std::ifstream settings("/sys/kernel/mm/transparent_hugepage/enabled");
+    std::string mode((std::istreambuf_iterator<char>(settings)), std::istreambuf_iterator<char>());
+    bool supported = !mode.empty() && mode.find("[never]") == std::string::npos;
+    bool advised = HugePages::advise(buffer, 2 * HUGE_PAGE_SIZE);
+    HugePages::release(buffer, 2 * HUGE_PAGE_SIZE + 1);
+    if (!supported) {
+        SKIP("Transparent huge pages are not available");
+    }
+    REQUIRE(advised);
+}
+
+TEST_CASE("ROM index records headers and only rescans changed files") {
+    std::filesystem::create_directories("test_library/sub");
+    writeTestROM("test_library/a.gb", 0x13, 0x01, 0x03);
+    writeTestROM("test_library/sub/b.gbc", 0x05);
+    std::ofstream("test_library/notes.txt") << "not a rom";
+    writeStoredZip("test_library/c.zip", "test_library/a.gb");
+    std::ifstream input("test_library/a.gb", std::ios::binary);
+    std::vector<u8> rom((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    gzFile gz = gzopen("test_library/d.gb.gz", "wb");
+    gzwrite(gz, rom.data(), rom.size());
+    gzclose(gz);
+
+    int scanned = 0;
+    REQUIRE(RomIndex::build("test_library", "test_library.index", &scanned));
+    REQUIRE(scanned == 4);
+
+    RomIndex index;
+    REQUIRE(index.open("test_library.index"));
+    REQUIRE(index.size() == 4);
+    const RomIndexEntry *entry = index.find("a.gb");
+    REQUIRE(entry != nullptr);
+    REQUIRE(std::string(entry->title) == "TESTROM");
+    REQUIRE(entry->mapper == MBC_3);
+    REQUIRE(entry->romSize == 0x10000);
+    REQUIRE(entry->ramSize == 0x8000);
+    REQUIRE(entry->headerValid);
+    REQUIRE(index.find("sub/b.gbc")->ramSize == MBC2_RAM_SIZE);
+    REQUIRE(index.find("missing.gb") == nullptr);
+
+    // Compressed ROMs are indexed by their decompressed contents
+    REQUIRE(index.find("c.zip")->contentHash == entry->contentHash);
+    REQUIRE(std::string(index.find("c.zip")->title) == "TESTROM");
+    REQUIRE(index.find("d.gb.gz")->contentHash == entry->contentHash);
+
+    // Unchanged files are taken from the old index
+    writeTestROM("test_library/sub/b.gbc", 0x06, 0x01);
+    REQUIRE(RomIndex::build("test_library", "test_library.index", &scanned));
+    REQUIRE(scanned == 1);
+    RomIndex refreshed;
+    REQUIRE(refreshed.open("test_library.index"));
+    REQUIRE(refreshed.find("sub/b.gbc")->cartridgeType == 0x06);
+    REQUIRE(refreshed.find("a.gb")->contentHash == entry->contentHash);
+
+    std::filesystem::remove_all("test_library");
+    std::remove("test_library.index");
+}
+
 // TEST_CASE("F register flags are accessible and initialized correctly") {
 //     MMU mmu;
 //     CPU cpu(&mmu);